@@ -0,0 +1,417 @@
+#include "stdafx.h"
+#include "BatchProgrammer.h"
+#include "MSP430EEMTarget.h"
+#include "FirmwareImage.h"
+#include "MSP430Util.h"
+#include <string>
+
+using namespace MSP430Proxy;
+
+static void PrintPhaseTime(const char *pPhase, DWORD milliseconds)
+{
+	printf("  %-10s %d.%03d sec\n", pPhase, milliseconds / 1000, milliseconds % 1000);
+}
+
+//Splits the image into the parts that need to be programmed as FLASH and the parts that are written directly (RAM, FRAM)
+static void ClassifySections(const std::vector<FirmwareImage::Section> &sections, const DEVICE_T &device, std::vector<FLASHWriteBuffer::Run> &flashRuns, std::vector<FLASHWriteBuffer::Run> &directRuns)
+{
+	std::vector<std::pair<unsigned, unsigned> > flashRanges;
+	if (!device.HasFramMemroy)
+	{
+		if (device.mainStart || device.mainEnd)
+			flashRanges.push_back(std::pair<unsigned, unsigned>(device.mainStart, device.mainEnd));
+		if (device.infoStart || device.infoEnd)
+			flashRanges.push_back(std::pair<unsigned, unsigned>(device.infoStart, device.infoEnd));
+	}
+
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		unsigned start = sections[i].Start, end = (unsigned)(sections[i].Start + sections[i].Data.size());
+		while (start < end)
+		{
+			bool isFLASH = false;
+			unsigned partEnd = end;
+			for (size_t j = 0; j < flashRanges.size(); j++)
+			{
+				if (start >= flashRanges[j].first && start <= flashRanges[j].second)
+				{
+					isFLASH = true;
+					if (partEnd > (flashRanges[j].second + 1))
+						partEnd = flashRanges[j].second + 1;
+				}
+				else if (start < flashRanges[j].first && partEnd > flashRanges[j].first)
+					partEnd = flashRanges[j].first;
+			}
+
+			FLASHWriteBuffer::Run run;
+			run.Start = start;
+			run.Data.assign(sections[i].Data.begin() + (start - sections[i].Start), sections[i].Data.begin() + (partEnd - sections[i].Start));
+			(isFLASH ? flashRuns : directRuns).push_back(run);
+			start = partEnd;
+		}
+	}
+}
+
+int MSP430Proxy::ProgramImageWithoutGDB( const GlobalSettings &settings )
+{
+	DWORD startTime = GetTickCount();
+	FirmwareImage image;
+	if (!image.Load(settings.ProgramImage))
+		return bpImageError;
+
+	size_t totalBytes = image.GetTotalSize();
+	printf("Loaded %s: %d bytes in %d section(s)\n", settings.ProgramImage, totalBytes, image.GetSections().size());
+
+	//The fast load mode replaces the per-write verification with a single MSP430_VerifyMem() pass
+	GlobalSettings targetSettings = settings;
+	targetSettings.AutoErase = false;
+	if (settings.VerifyImage)
+		targetSettings.FastLoad = true;
+
+	DWORD connectStartTime = GetTickCount();
+	MSP430EEMTarget target;
+	if (!target.Initialize(targetSettings))
+	{
+		printf("Cannot connect to the MSP430 device on %s\n", settings.PortName);
+		return bpConnectionError;
+	}
+
+	DWORD programStartTime = GetTickCount();
+	std::vector<FLASHWriteBuffer::Run> flashRuns, directRuns;
+	ClassifySections(image.GetSections(), target.GetDeviceInfo(), flashRuns, directRuns);
+
+	//The FLASH data is programmed the same way as gdb does it: all erase requests first, then the data, then vFlashDone
+	bool succeeded = true;
+	const DEVICE_T &device = target.GetDeviceInfo();
+	for (size_t i = 0; succeeded && i < flashRuns.size(); i++)
+	{
+		unsigned segmentSize = (flashRuns[i].Start >= device.mainStart && flashRuns[i].Start <= device.mainEnd) ? FLASHWriteBuffer::SEGMENT_SIZE : GetInfoSegmentSize(device);
+		unsigned eraseStart = flashRuns[i].Start & ~(segmentSize - 1);
+		unsigned eraseEnd = (unsigned)(flashRuns[i].Start + flashRuns[i].Data.size() + segmentSize - 1) & ~(segmentSize - 1);
+		succeeded = target.EraseFLASH(eraseStart, eraseEnd - eraseStart) == kGDBSuccess;
+	}
+	for (size_t i = 0; succeeded && i < flashRuns.size(); i++)
+		succeeded = target.WriteFLASH(flashRuns[i].Start, &flashRuns[i].Data[0], flashRuns[i].Data.size()) == kGDBSuccess;
+	if (!flashRuns.empty())
+	{
+		//vFlashDone also ends the fast load mode, so it is sent even if one of the previous steps failed
+		if (target.CommitFLASHWrite() != kGDBSuccess)
+			succeeded = false;
+	}
+
+	DWORD directWriteStartTime = GetTickCount();
+	if (succeeded)
+		succeeded = target.WriteTargetMemoryRuns(directRuns) == kGDBSuccess;
+	DWORD directWriteTime = GetTickCount() - directWriteStartTime;
+
+	const MSP430GDBTarget::FLASHLoadStatistics &stats = target.GetFLASHLoadStatistics();
+	if (!succeeded)
+	{
+		//A mismatch found by the fast load verification is reported separately from the programming errors
+		if (stats.VerificationFailed)
+		{
+			printf("Verification FAILED\n");
+			return bpVerificationError;
+		}
+		printf("Programming FAILED\n");
+		return bpProgrammingError;
+	}
+
+	DWORD verifyStartTime = GetTickCount();
+	if (settings.VerifyImage)
+	{
+		//The FLASH runs are normally verified by the fast load mode. If it could not be enabled, they are verified here.
+		std::vector<FLASHWriteBuffer::Run> runsToVerify = directRuns;
+		if (!stats.Verified)
+			runsToVerify.insert(runsToVerify.end(), flashRuns.begin(), flashRuns.end());
+
+		if (!runsToVerify.empty() && !target.VerifyMemoryRuns(runsToVerify))
+		{
+			printf("Verification FAILED\n");
+			return bpVerificationError;
+		}
+	}
+	DWORD endTime = GetTickCount();
+
+	//The device is restarted from the reset vector and keeps running after the proxy exits
+	std::string output;
+	if (MSP430_Reset(ALL_RESETS, FALSE, FALSE) != STATUS_OK || target.ExecuteRemoteCommand("detach", output) != kGDBSuccess)
+		printf("Warning: cannot start the programmed firmware: %s\n", GetLastMSP430Error());
+
+	DWORD programmingTime = endTime - programStartTime;
+	printf("Programming %s:\n", settings.VerifyImage ? "and verification succeeded" : "succeeded");
+	PrintPhaseTime("parse", connectStartTime - startTime);
+	PrintPhaseTime("connect", programStartTime - connectStartTime);
+	PrintPhaseTime("erase", stats.EraseTime);
+	PrintPhaseTime("program", stats.ProgramTime + directWriteTime);
+	PrintPhaseTime("verify", stats.VerifyTime + (endTime - verifyStartTime));
+	PrintPhaseTime("total", endTime - startTime);
+	printf("%d bytes programmed in %d.%03d sec (%d bytes/sec)\n", totalBytes, programmingTime / 1000, programmingTime % 1000,
+		programmingTime ? (unsigned)((ULONGLONG)totalBytes * 1000 / programmingTime) : totalBytes);
+
+	return bpSucceeded;
+}
+
+static const char *GetResultText(DWORD exitCode)
+{
+	switch(exitCode)
+	{
+	case bpSucceeded:
+		return "OK";
+	case bpImageError:
+		return "cannot read image";
+	case bpConnectionError:
+		return "cannot connect";
+	case bpProgrammingError:
+		return "programming FAILED";
+	case bpVerificationError:
+		return "verification FAILED";
+	default:
+		return "process FAILED";
+	}
+}
+
+static bool EnumerateUSBProbes(std::vector<std::string> &ports)
+{
+	LONG count = 0;
+	if (MSP430_GetNumberOfUsbIfs(&count) != STATUS_OK)
+	{
+		printf("Cannot enumerate USB FET probes: %s\n", GetLastMSP430Error());
+		return false;
+	}
+
+	for (LONG i = 0; i < count; i++)
+	{
+		char *pName = NULL;
+		LONG status = 0;
+		if (MSP430_GetNameOfUsbIf(i, &pName, &status) != STATUS_OK || !pName)
+			continue;
+		if (status == ENABLE)
+			printf("Skipping %s: the probe is used by another debugger\n", pName);
+		else
+			ports.push_back(pName);
+	}
+	return true;
+}
+
+namespace
+{
+	struct ProbeJob
+	{
+		std::string Port, LogFile;
+		HANDLE hProcess;
+		DWORD StartTime, ElapsedTime;
+		DWORD ExitCode;
+	};
+}
+
+static bool StartProbeJob(ProbeJob &job, const std::string &exePath, const std::string &imageFile, const std::string &forwardedOptions, bool verify)
+{
+	job.hProcess = NULL;
+	job.ExitCode = (DWORD)-1;
+	job.ElapsedTime = 0;
+
+	SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+	HANDLE hLog = CreateFileA(job.LogFile.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hLog == INVALID_HANDLE_VALUE)
+		return false;
+
+	//Each child counts the FLASH erase cycles in its own file, as the counter files are named after the FET port
+	std::string commandLine = "\"" + exePath + "\" --program=\"" + imageFile + "\" --progport=" + job.Port + forwardedOptions;
+	if (verify)
+		commandLine += " --verify";
+
+	STARTUPINFOA startupInfo = {sizeof(startupInfo), };
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = startupInfo.hStdError = hLog;
+
+	PROCESS_INFORMATION processInfo;
+	std::vector<char> commandLineBuffer(commandLine.begin(), commandLine.end());
+	commandLineBuffer.push_back(0);
+
+	job.StartTime = GetTickCount();
+	BOOL created = CreateProcessA(exePath.c_str(), &commandLineBuffer[0], NULL, NULL, TRUE, 0, NULL, NULL, &startupInfo, &processInfo);
+	CloseHandle(hLog);
+	if (!created)
+		return false;
+
+	CloseHandle(processInfo.hThread);
+	job.hProcess = processInfo.hProcess;
+	return true;
+}
+
+//! Terminates the running children so that the image file can be deleted and no probe is left half-programmed unnoticed
+static void StopProbeJobs(std::vector<ProbeJob> &jobs, const std::vector<size_t> &running)
+{
+	for (size_t i = 0; i < running.size(); i++)
+	{
+		ProbeJob &job = jobs[running[i]];
+		TerminateProcess(job.hProcess, bpProgrammingError);
+		WaitForSingleObject(job.hProcess, INFINITE);
+
+		job.ElapsedTime = GetTickCount() - job.StartTime;
+		if (!GetExitCodeProcess(job.hProcess, &job.ExitCode))
+			job.ExitCode = bpProgrammingError;
+		CloseHandle(job.hProcess);
+		job.hProcess = NULL;
+	}
+}
+
+static void PrintLogFile(const std::string &fileName)
+{
+	FILE *pFile = fopen(fileName.c_str(), "r");
+	if (!pFile)
+		return;
+
+	char szLine[512];
+	while (fgets(szLine, sizeof(szLine), pFile))
+		printf("    %s", szLine);
+	fclose(pFile);
+}
+
+int MSP430Proxy::ProgramImageOnMultipleProbes( const GlobalSettings &settings, int argc, char *argv[] )
+{
+	DWORD startTime = GetTickCount();
+	FirmwareImage image;
+	if (!image.Load(settings.ProgramImage))
+		return bpImageError;
+	DWORD parseTime = GetTickCount() - startTime;
+
+	std::vector<std::string> ports;
+	if (settings.GangPorts && settings.GangPorts[0])
+	{
+		std::string list = settings.GangPorts;
+		for (size_t pos = 0; pos <= list.length(); )
+		{
+			size_t next = list.find(',', pos);
+			if (next == std::string::npos)
+				next = list.length();
+			if (next > pos)
+				ports.push_back(list.substr(pos, next - pos));
+			pos = next + 1;
+		}
+	}
+	else if (!EnumerateUSBProbes(ports))
+		return bpConnectionError;
+
+	if (ports.empty())
+	{
+		printf("No FET probes found\n");
+		return bpConnectionError;
+	}
+
+	char szTempDir[MAX_PATH] = {0,}, szImageFile[MAX_PATH] = {0,}, szExePath[MAX_PATH] = {0,};
+	GetTempPathA(__countof(szTempDir), szTempDir);
+	GetModuleFileNameA(NULL, szExePath, __countof(szExePath));
+	if (!GetTempFileNameA(szTempDir, "msp", 0, szImageFile) || !image.SaveSectionDump(szImageFile))
+	{
+		printf("Cannot create a temporary image file in %s\n", szTempDir);
+		return bpImageError;
+	}
+
+	std::string forwardedOptions;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		std::string name = arg.substr(0, arg.find('='));
+		if (name != "--program" && name != "--gang" && name != "--progport" && name != "--verify")
+			forwardedOptions += " \"" + arg + "\"";
+	}
+
+	//The children still split the image into the FLASH and RAM parts, as that needs the device information read after connecting
+	printf("Parsed %s in %d.%03d sec. Programming %d bytes to %d probe(s)...\n", settings.ProgramImage, parseTime / 1000, parseTime % 1000, image.GetTotalSize(), ports.size());
+
+	std::vector<ProbeJob> jobs(ports.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		jobs[i].Port = ports[i];
+		jobs[i].hProcess = NULL;
+		jobs[i].ElapsedTime = 0;
+		jobs[i].ExitCode = (DWORD)-1;
+	}
+
+	std::vector<size_t> running;
+	size_t nextJob = 0, finishedJobs = 0;
+	while (finishedJobs < jobs.size())
+	{
+		//WaitForMultipleObjects() can only wait for MAXIMUM_WAIT_OBJECTS processes, so larger racks are programmed in waves
+		while (nextJob < jobs.size() && running.size() < MAXIMUM_WAIT_OBJECTS)
+		{
+			ProbeJob &job = jobs[nextJob];
+
+			char szLogFile[MAX_PATH] = {0,};
+			GetTempFileNameA(szTempDir, "msp", 0, szLogFile);
+			job.LogFile = szLogFile;
+
+			if (StartProbeJob(job, szExePath, szImageFile, forwardedOptions, settings.VerifyImage))
+				running.push_back(nextJob);
+			else
+			{
+				printf("Cannot start a programming process for %s\n", job.Port.c_str());
+				finishedJobs++;
+			}
+			nextJob++;
+		}
+
+		if (running.empty())
+			continue;
+
+		std::vector<HANDLE> handles;
+		for (size_t i = 0; i < running.size(); i++)
+			handles.push_back(jobs[running[i]].hProcess);
+
+		DWORD waitResult = WaitForMultipleObjects((DWORD)handles.size(), &handles[0], FALSE, INFINITE);
+		if (waitResult >= (WAIT_OBJECT_0 + handles.size()))
+		{
+			printf("Cannot wait for the programming processes (error %d). Stopping the remaining probes...\n", GetLastError());
+			StopProbeJobs(jobs, running);
+			break;
+		}
+
+		ProbeJob &job = jobs[running[waitResult - WAIT_OBJECT_0]];
+		job.ElapsedTime = GetTickCount() - job.StartTime;
+		GetExitCodeProcess(job.hProcess, &job.ExitCode);
+		CloseHandle(job.hProcess);
+		job.hProcess = NULL;
+
+		running.erase(running.begin() + (waitResult - WAIT_OBJECT_0));
+		finishedJobs++;
+		printf("%s: %s\n", job.Port.c_str(), GetResultText(job.ExitCode));
+	}
+
+	DeleteFileA(szImageFile);
+
+	DWORD totalTime = GetTickCount() - startTime, sumOfTimes = 0;
+	DWORD worstResult = bpSucceeded;
+	unsigned succeededProbes = 0;
+
+	printf("\n%-24s %-20s %s\n", "Probe", "Result", "Time");
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const ProbeJob &job = jobs[i];
+		printf("%-24s %-20s %d.%03d sec\n", job.Port.c_str(), GetResultText(job.ExitCode), job.ElapsedTime / 1000, job.ElapsedTime % 1000);
+		sumOfTimes += job.ElapsedTime;
+		if (job.ExitCode == bpSucceeded)
+			succeededProbes++;
+		else if (job.ExitCode > worstResult && job.ExitCode <= bpVerificationError)
+			worstResult = job.ExitCode;
+	}
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].ExitCode != bpSucceeded)
+		{
+			printf("\nOutput from %s:\n", jobs[i].Port.c_str());
+			PrintLogFile(jobs[i].LogFile);
+		}
+		DeleteFileA(jobs[i].LogFile.c_str());
+	}
+
+	printf("\n%d of %d probe(s) programmed successfully in %d.%03d sec (%d.%03d sec if programmed sequentially)\n", succeededProbes, jobs.size(),
+		totalTime / 1000, totalTime % 1000, sumOfTimes / 1000, sumOfTimes % 1000);
+
+	if (succeededProbes != jobs.size() && worstResult == bpSucceeded)
+		worstResult = bpProgrammingError;
+	return (int)worstResult;
+}
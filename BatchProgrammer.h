@@ -0,0 +1,35 @@
+#pragma once
+#include "settings.h"
+
+namespace MSP430Proxy
+{
+	//! Exit codes of the batch programming mode
+	enum BatchProgrammingResult
+	{
+		bpSucceeded = 0,
+		bpImageError = 1,
+		bpConnectionError = 2,
+		bpProgrammingError = 3,
+		bpVerificationError = 4,
+	};
+
+	//! Programs the image specified by GlobalSettings::ProgramImage without a gdb session (--program option)
+	/*! The image is programmed through the same FLASH paths as the gdb "load" command (vFlashErase/vFlashWrite/vFlashDone),
+		so the unchanged segments are skipped and the entire main FLASH is mass-erased when that is faster.
+		If GlobalSettings::VerifyImage is set, the fast load mode is used and all programmed data is checked with MSP430_VerifyMem().
+		After programming the device is reset and released from JTAG.
+		\return One of the BatchProgrammingResult values that should be used as the process exit code
+	*/
+	int ProgramImageWithoutGDB(const GlobalSettings &settings);
+
+	//! Programs the same image to several FET probes in parallel (--gang option)
+	/*! MSP430.DLL can only drive one probe per process, so a child msp430-gdbproxy process running ProgramImageWithoutGDB() is
+		started for each probe. The image is parsed once and passed to the children as a section dump (see FirmwareImage::SaveSectionDump()),
+		so they only read it. Each child counts the FLASH erase cycles of its board in a separate file (see FLASHWearCounter).
+		The output of each child is saved to a log file that is shown if the probe fails. When all children exit,
+		a table with the result and the time of each probe is printed.
+		\param argv Specifies the original command line. All options except --program, --gang and --progport are forwarded to the children.
+		\return bpSucceeded if all probes were programmed successfully, otherwise the highest exit code reported by a child
+	*/
+	int ProgramImageOnMultipleProbes(const GlobalSettings &settings, int argc, char *argv[]);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <windows.h>
+
+/*! \page benchmarks Benchmarks
+	The msp430-benchmarks project runs the proxy code against the fake MSP430.DLL implementation (see FakeMSP430.h)
+	and measures the host-side overhead of the operations that are hard to measure with a real FET probe.
+	Usage: msp430-benchmarks <name> [options]. Running it without arguments lists the available benchmarks.
+
+	The gang programming mode starts a separate process for each probe, so it is measured by running msp430-gdbproxy.exe
+	itself with the fake MSP430.DLL built by the FakeMSP430 project: GangBenchmark.bat <image file> [number of probes].
+*/
+
+//! Returns a timestamp in microseconds for measuring the benchmark phases
+inline unsigned long long GetBenchmarkTime()
+{
+	LARGE_INTEGER frequency, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)(now.QuadPart * 1000000.0 / frequency.QuadPart);
+}
+
+//! Waits for the given amount of time without using the CPU, like a thread waiting for the FET or for the gdb socket
+/*! Sleep() only has a millisecond resolution (see the timeBeginPeriod() call in main()), so the remainder is spent spinning */
+inline void BenchmarkWait(unsigned long long microseconds)
+{
+	unsigned long long end = GetBenchmarkTime() + microseconds;
+	if (microseconds >= 2000)
+		Sleep((DWORD)(microseconds / 1000) - 1);
+	while (GetBenchmarkTime() < end)
+		;
+}
+
+//! Parses a "--name=value" option. Returns false if the argument is a different option.
+bool ParseBenchmarkOption(const char *pArg, const char *pName, unsigned *pValue);
+
+//! Measures the FLASH load time with and without the JTAG worker pipeline (see MSP430GDBTarget::StartPipelinedFLASHLoad())
+int RunFLASHPipelineBenchmark(int argc, char *argv[]);
+
+//! Measures the host-side cost of SoftwareBreakpointManager::CommitBreakpoints() for different FLASH sizes
+int RunBreakpointCommitBenchmark(int argc, char *argv[]);
+
+//! Measures SoftwareBreakpointManager::HideOrRestoreBreakpointsInMemorySnapshot() for the entire FLASH with 0, 10 and 1000 breakpoints
+int RunBreakpointSnapshotBenchmark(int argc, char *argv[]);
+
+//! Checks and measures the breakpoint commits when the FLASH shadow no longer matches the device (see SoftwareBreakpointManager::CompareWords())
+int RunStaleShadowBenchmark(int argc, char *argv[]);
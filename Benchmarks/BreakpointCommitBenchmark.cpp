@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include "FakeMSP430.h"
+#include "SoftwareBreakpointManager.h"
+#include "TargetMemoryCache.h"
+
+using namespace MSP430Proxy;
+
+enum
+{
+	MAIN_SEGMENT_SIZE = 512,
+	BREAK_INSTRUCTION = 0x4343,
+	FEW_BREAKPOINTS = 10,
+};
+
+static bool MeasureBreakpointCommits(unsigned flashStart, unsigned flashEnd, bool breakpointInEverySegment, unsigned iterations)
+{
+	FakeMSP430::SetMainFLASHRange(flashStart, flashEnd);
+	FakeMSP430::FillMemory(flashStart, flashEnd, flashEnd);
+
+	TargetMemoryCache cache;
+	cache.AddRegion("main", flashStart, flashEnd, rpCacheable | rpPrefetchable | rpImmutableWhileHalted | rpWriteThrough);
+	cache.EnableFLASHShadow(flashStart, flashEnd, MAIN_SEGMENT_SIZE);
+
+	SoftwareBreakpointManager manager(flashStart, flashEnd, BREAK_INSTRUCTION, &cache, NULL, true, false);
+
+	//A breakpoint in every segment produces the largest possible segment map. A typical session uses a few breakpoints.
+	unsigned segmentCount = (flashEnd - flashStart + MAIN_SEGMENT_SIZE) / MAIN_SEGMENT_SIZE;
+	unsigned breakpointCount = breakpointInEverySegment ? segmentCount : FEW_BREAKPOINTS;
+	for (unsigned i = 0; i < breakpointCount; i++)
+		manager.SetBreakpoint(flashStart + (i * (segmentCount / breakpointCount)) * MAIN_SEGMENT_SIZE);
+	if (!manager.CommitBreakpoints())
+	{
+		printf("Failed to commit the initial breakpoints\n");
+		return false;
+	}
+
+	size_t recordCount = 0, segmentMapSize = manager.GetSegmentMapSize(&recordCount);
+
+	//gdb commits the breakpoints each time the target is resumed, even if they have not changed
+	FakeMSP430::ResetStatistics();
+	unsigned long long startTime = GetBenchmarkTime();
+	for (unsigned i = 0; i < iterations; i++)
+		manager.CommitBreakpoints();
+	unsigned long long idleTime = GetBenchmarkTime() - startTime;
+
+	//Single stepping over a line sets a temporary breakpoint, resumes the target and removes the breakpoint
+	unsigned tempBreakpoint = flashStart + (segmentCount / 2) * MAIN_SEGMENT_SIZE + 2;
+	FakeMSP430::ResetStatistics();
+	startTime = GetBenchmarkTime();
+	for (unsigned i = 0; i < iterations; i++)
+	{
+		if (!manager.SetBreakpoint(tempBreakpoint) || !manager.CommitBreakpoints() || !manager.RemoveBreakpoint(tempBreakpoint) || !manager.CommitBreakpoints())
+		{
+			printf("Failed to set or remove a temporary breakpoint at 0x%x\n", tempBreakpoint);
+			return false;
+		}
+	}
+	unsigned long long stepTime = GetBenchmarkTime() - startTime;
+	unsigned stepCalls = FakeMSP430::GetStatistics().Calls;
+
+	printf("%7d KB %5d breakpoints  segment map: %4d records, %7d bytes  no-op commit: %6d ns  set/commit/remove/commit: %6d ns (%d API calls)\n",
+		(flashEnd - flashStart + 1) / 1024, breakpointCount, recordCount, segmentMapSize,
+		(unsigned)(idleTime * 1000 / iterations), (unsigned)(stepTime * 1000 / iterations), stepCalls / iterations);
+	return true;
+}
+
+int RunBreakpointCommitBenchmark( int argc, char *argv[] )
+{
+	unsigned iterations = 10000;
+	for (int i = 0; i < argc; i++)
+	{
+		if (!ParseBenchmarkOption(argv[i], "iterations", &iterations))
+		{
+			printf("Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (!iterations)
+	{
+		printf("The iteration count should be positive\n");
+		return 1;
+	}
+
+	//Only the host-side overhead is measured, so the fake FET responds instantly
+	FakeMSP430::Timing timing;
+	timing.CallMicroseconds = timing.WriteByteNanoseconds = timing.ReadByteNanoseconds = timing.SegmentEraseMicroseconds = 0;
+	FakeMSP430::SetTiming(timing);
+
+	printf("Committing breakpoints %d times with %d breakpoints and with a breakpoint in every FLASH segment\n", iterations, FEW_BREAKPOINTS);
+
+	//48 KB (MSP430F1611), 256 KB, 512 KB and 1 MB devices
+	static const unsigned flashEnds[] = {0xFFFF, 0x43FFF, 0x83FFF, 0xFFFFF};
+	for (size_t i = 0; i < __countof(flashEnds); i++)
+		if (!MeasureBreakpointCommits(0x4000, flashEnds[i], false, iterations) || !MeasureBreakpointCommits(0x4000, flashEnds[i], true, iterations))
+			return 1;
+	return 0;
+}
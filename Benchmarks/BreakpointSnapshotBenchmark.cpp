@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include "FakeMSP430.h"
+#include "SoftwareBreakpointManager.h"
+#include "TargetMemoryCache.h"
+
+using namespace MSP430Proxy;
+
+enum
+{
+	MAIN_SEGMENT_SIZE = 512,
+	BREAK_INSTRUCTION = 0x4343,
+};
+
+static bool MeasureSnapshotHiding(unsigned flashStart, unsigned flashEnd, unsigned breakpointCount, unsigned iterations)
+{
+	FakeMSP430::SetMainFLASHRange(flashStart, flashEnd);
+	FakeMSP430::FillMemory(flashStart, flashEnd, flashEnd);
+
+	TargetMemoryCache cache;
+	cache.AddRegion("main", flashStart, flashEnd, rpCacheable | rpPrefetchable | rpImmutableWhileHalted | rpWriteThrough);
+	cache.EnableFLASHShadow(flashStart, flashEnd, MAIN_SEGMENT_SIZE);
+
+	SoftwareBreakpointManager manager(flashStart, flashEnd, BREAK_INSTRUCTION, &cache, NULL, true, false);
+
+	//The breakpoints are spread evenly over the FLASH, so with many breakpoints most segments contain several of them
+	unsigned flashSize = flashEnd - flashStart + 1;
+	for (unsigned i = 0; i < breakpointCount; i++)
+		manager.SetBreakpoint(flashStart + (unsigned)(((unsigned long long)flashSize * i / breakpointCount) & ~1));
+	if (!manager.CommitBreakpoints())
+	{
+		printf("Failed to commit the breakpoints\n");
+		return false;
+	}
+
+	std::vector<unsigned char> snapshot(FakeMSP430::GetMemory() + flashStart, FakeMSP430::GetMemory() + flashEnd + 1);
+
+	unsigned long long startTime = GetBenchmarkTime();
+	for (unsigned i = 0; i < iterations; i++)
+		manager.HideOrRestoreBreakpointsInMemorySnapshot(flashStart, &snapshot[0], snapshot.size(), true);
+	unsigned long long elapsed = GetBenchmarkTime() - startTime;
+
+	//After hiding, the snapshot should contain the original instructions at all breakpoint addresses
+	unsigned remainingBreakpoints = 0;
+	for (unsigned i = 0; i < breakpointCount; i++)
+	{
+		unsigned addr = flashStart + (unsigned)(((unsigned long long)flashSize * i / breakpointCount) & ~1);
+		unsigned short originalInsn;
+		if (!manager.GetOriginalInstruction(addr, &originalInsn) || memcmp(&snapshot[addr - flashStart], &originalInsn, 2))
+			remainingBreakpoints++;
+	}
+
+	if (remainingBreakpoints)
+	{
+		printf("%d breakpoint(s) were not hidden\n", remainingBreakpoints);
+		return false;
+	}
+
+	printf("%7d KB %5d breakpoints: %8d ns per snapshot\n", flashSize / 1024, breakpointCount, (unsigned)(elapsed * 1000 / iterations));
+	return true;
+}
+
+int RunBreakpointSnapshotBenchmark( int argc, char *argv[] )
+{
+	unsigned iterations = 1000;
+	for (int i = 0; i < argc; i++)
+	{
+		if (!ParseBenchmarkOption(argv[i], "iterations", &iterations))
+		{
+			printf("Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (!iterations)
+	{
+		printf("The iteration count should be positive\n");
+		return 1;
+	}
+
+	//Only the host-side overhead is measured, so the fake FET responds instantly
+	FakeMSP430::Timing timing;
+	timing.CallMicroseconds = timing.WriteByteNanoseconds = timing.ReadByteNanoseconds = timing.SegmentEraseMicroseconds = 0;
+	FakeMSP430::SetTiming(timing);
+
+	printf("Hiding software breakpoints in a snapshot of the entire FLASH %d times\n", iterations);
+
+	static const unsigned flashEnds[] = {0xFFFF, 0xFFFFF};
+	static const unsigned breakpointCounts[] = {0, 10, 1000};
+	for (size_t i = 0; i < __countof(flashEnds); i++)
+		for (size_t j = 0; j < __countof(breakpointCounts); j++)
+			if (!MeasureSnapshotHiding(0x4000, flashEnds[i], breakpointCounts[j], iterations))
+				return 1;
+	return 0;
+}
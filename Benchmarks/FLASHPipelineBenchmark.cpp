@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include "FakeMSP430.h"
+#include "MSP430EEMTarget.h"
+
+using namespace GDBServerFoundation;
+using namespace MSP430Proxy;
+
+struct PipelineBenchmarkParams
+{
+	unsigned ImageSize, PacketSize, PacketMicroseconds;
+};
+
+static bool RunFLASHLoad(const PipelineBenchmarkParams &params, bool pipelined, const std::vector<unsigned char> &image)
+{
+	GlobalSettings settings;
+	settings.CountFLASHWear = false;
+	settings.PipelinedFLASHLoad = pipelined;
+
+	//The device contains a different firmware, so most segments need to be erased
+	FakeMSP430::FillMemory(0x4000, 0xFFFF, pipelined ? 1 : 2);
+
+	MSP430EEMTarget target;
+	if (!target.Initialize(settings))
+		return false;
+
+	const DEVICE_T &device = target.GetDeviceInfo();
+	unsigned eraseLength = (params.ImageSize + 511) & ~511;
+
+	FakeMSP430::ResetStatistics();
+	unsigned long long startTime = GetBenchmarkTime();
+
+	//gdb sends the erase requests for all sections before the first vFlashWrite packet
+	bool succeeded = target.EraseFLASH(device.mainStart, eraseLength) == kGDBSuccess;
+	for (unsigned offset = 0; succeeded && offset < params.ImageSize; offset += params.PacketSize)
+	{
+		unsigned todo = (params.PacketSize < (params.ImageSize - offset)) ? params.PacketSize : (params.ImageSize - offset);
+		//Time needed by gdb to format and send the packet
+		BenchmarkWait(params.PacketMicroseconds);
+		succeeded = target.WriteFLASH(device.mainStart + offset, &image[offset], todo) == kGDBSuccess;
+	}
+	if (succeeded)
+		succeeded = target.CommitFLASHWrite() == kGDBSuccess;
+
+	unsigned long long elapsed = GetBenchmarkTime() - startTime;
+	FakeMSP430::Statistics stats = FakeMSP430::GetStatistics();
+	if (!succeeded)
+	{
+		printf("%s load FAILED\n", pipelined ? "Pipelined" : "Sequential");
+		return false;
+	}
+
+	if (memcmp(FakeMSP430::GetMemory() + device.mainStart, &image[0], params.ImageSize))
+	{
+		printf("%s load produced wrong FLASH contents\n", pipelined ? "Pipelined" : "Sequential");
+		return false;
+	}
+
+	unsigned long long packetTime = (unsigned long long)((params.ImageSize + params.PacketSize - 1) / params.PacketSize) * params.PacketMicroseconds;
+	printf("%-10s %8d.%03d ms  (FET busy %d.%03d ms, gdb packets %d.%03d ms, %d KB/s)\n", pipelined ? "pipelined" : "sequential",
+		(unsigned)(elapsed / 1000), (unsigned)(elapsed % 1000),
+		(unsigned)(stats.BusyMicroseconds / 1000), (unsigned)(stats.BusyMicroseconds % 1000),
+		(unsigned)(packetTime / 1000), (unsigned)(packetTime % 1000),
+		(unsigned)((unsigned long long)params.ImageSize * 1000000 / 1024 / elapsed));
+	return true;
+}
+
+int RunFLASHPipelineBenchmark( int argc, char *argv[] )
+{
+	PipelineBenchmarkParams params = {32768, 1024, 3000};
+	FakeMSP430::Timing timing;
+	for (int i = 0; i < argc; i++)
+	{
+		if (!ParseBenchmarkOption(argv[i], "size", &params.ImageSize) &&
+			!ParseBenchmarkOption(argv[i], "packet", &params.PacketSize) &&
+			!ParseBenchmarkOption(argv[i], "packet_us", &params.PacketMicroseconds) &&
+			!ParseBenchmarkOption(argv[i], "call_us", &timing.CallMicroseconds) &&
+			!ParseBenchmarkOption(argv[i], "write_ns", &timing.WriteByteNanoseconds) &&
+			!ParseBenchmarkOption(argv[i], "erase_us", &timing.SegmentEraseMicroseconds))
+		{
+			printf("Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	//The image should not cover the entire main FLASH, otherwise it is mass-erased and programmed on vFlashDone in both modes
+	if (!params.ImageSize || !params.PacketSize || params.ImageSize > 0xB000)
+	{
+		printf("The image size should be between 1 and %d bytes\n", 0xB000);
+		return 1;
+	}
+
+	FakeMSP430::SetTiming(timing);
+
+	std::vector<unsigned char> image(params.ImageSize);
+	for (size_t i = 0; i < image.size(); i++)
+		image[i] = (unsigned char)((i * 7) ^ (i >> 8));
+
+	printf("Loading %d bytes in %d-byte packets (%d us per packet), FET: %d us per call, %d ns per byte, %d us per erase\n",
+		params.ImageSize, params.PacketSize, params.PacketMicroseconds, timing.CallMicroseconds, timing.WriteByteNanoseconds, timing.SegmentEraseMicroseconds);
+
+	if (!RunFLASHLoad(params, false, image) || !RunFLASHLoad(params, true, image))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,355 @@
+#include "stdafx.h"
+#include "FakeMSP430.h"
+#include "Benchmarks.h"
+#include "TI/Inc/MSP430.h"
+#include "TI/Inc/MSP430_Debug.h"
+#include "TI/Inc/MSP430_EEM.h"
+#include <vector>
+
+using namespace FakeMSP430;
+
+enum
+{
+	ADDRESS_SPACE_SIZE = 0x100000,
+	MAIN_SEGMENT_SIZE = 512,
+	INFO_SEGMENT_SIZE = 128,
+	INFO_START = 0x1000,
+	INFO_END = 0x10FF,
+	RAM_START = 0x1100,
+	RAM_END = 0x38FF,
+};
+
+static std::vector<unsigned char> s_Memory(ADDRESS_SPACE_SIZE, 0xFF);
+static unsigned s_MainStart = 0x4000, s_MainEnd = 0xFFFF;
+static Timing s_Timing;
+static Statistics s_Stats;
+static LONG s_Registers[16];
+static LONG s_LastError;
+static WORD s_NextBreakpointHandle = 1;
+
+//The real DLL waits for the USB transfers, so the calling thread does not use the CPU meanwhile
+static void BeginCall(unsigned long long extraNanoseconds)
+{
+	unsigned long long delay = s_Timing.CallMicroseconds + extraNanoseconds / 1000;
+	s_Stats.Calls++;
+	s_Stats.BusyMicroseconds += delay;
+	BenchmarkWait(delay);
+}
+
+static void ReadTimingFromEnvironment()
+{
+	static const struct
+	{
+		const char *pName;
+		unsigned Timing::*pField;
+	} variables[] = {
+		{"FAKE_MSP430_CALL_US", &Timing::CallMicroseconds},
+		{"FAKE_MSP430_WRITE_NS", &Timing::WriteByteNanoseconds},
+		{"FAKE_MSP430_READ_NS", &Timing::ReadByteNanoseconds},
+		{"FAKE_MSP430_ERASE_US", &Timing::SegmentEraseMicroseconds},
+	};
+
+	for (size_t i = 0; i < __countof(variables); i++)
+	{
+		const char *pValue = getenv(variables[i].pName);
+		if (pValue)
+			s_Timing.*variables[i].pField = strtoul(pValue, NULL, 0);
+	}
+}
+
+static STATUS_T Fail(LONG error)
+{
+	s_LastError = error;
+	return STATUS_ERROR;
+}
+
+static bool IsFLASH(unsigned addr)
+{
+	return (addr >= INFO_START && addr <= INFO_END) || (addr >= s_MainStart && addr <= s_MainEnd);
+}
+
+static unsigned EraseSegments(unsigned start, unsigned end)
+{
+	unsigned count = 0;
+	for (unsigned addr = start; addr <= end; )
+	{
+		unsigned segmentSize = (addr >= INFO_START && addr <= INFO_END) ? INFO_SEGMENT_SIZE : MAIN_SEGMENT_SIZE;
+		unsigned segmentStart = addr & ~(segmentSize - 1), segmentEnd = segmentStart + segmentSize - 1;
+		for (unsigned i = segmentStart; i <= segmentEnd; i++)
+			if (IsFLASH(i))
+				s_Memory[i] = 0xFF;
+		count++;
+		addr = segmentEnd + 1;
+	}
+	return count;
+}
+
+void FakeMSP430::SetTiming( const Timing &timing )
+{
+	s_Timing = timing;
+}
+
+void FakeMSP430::SetMainFLASHRange( unsigned mainStart, unsigned mainEnd )
+{
+	s_MainStart = mainStart;
+	s_MainEnd = mainEnd;
+}
+
+void FakeMSP430::FillMemory( unsigned start, unsigned end, unsigned seed )
+{
+	for (unsigned addr = start; addr <= end; addr++)
+	{
+		seed = seed * 1103515245 + 12345;
+		s_Memory[addr] = (unsigned char)(seed >> 16);
+	}
+}
+
+const unsigned char *FakeMSP430::GetMemory()
+{
+	return &s_Memory[0];
+}
+
+void FakeMSP430::SetMemory( unsigned addr, const void *pData, size_t length )
+{
+	memcpy(&s_Memory[addr], pData, length);
+}
+
+void FakeMSP430::ResetStatistics()
+{
+	memset(&s_Stats, 0, sizeof(s_Stats));
+}
+
+Statistics FakeMSP430::GetStatistics()
+{
+	return s_Stats;
+}
+
+STATUS_T WINAPI MSP430_GetNumberOfUsbIfs(LONG* Number)
+{
+	const char *pCount = getenv("FAKE_MSP430_PROBES");
+	*Number = pCount ? atoi(pCount) : 1;
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_GetNameOfUsbIf(LONG Idx, CHAR** Name, LONG* Status)
+{
+	static char szNames[MAXIMUM_WAIT_OBJECTS * 2][16];
+	if (Idx < 0 || (size_t)Idx >= __countof(szNames))
+		return Fail(PARAMETER_ERR);
+
+	_snprintf(szNames[Idx], sizeof(szNames[Idx]), "FAKE%d", Idx + 1);
+	*Name = szNames[Idx];
+	*Status = 0;
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Initialize(CHAR* port, LONG* version)
+{
+	ReadTimingFromEnvironment();
+	//Sleep() is used to model the USB latency, so it needs the millisecond resolution in every process using the fake DLL
+	timeBeginPeriod(1);
+	BeginCall(0);
+	//Allows testing how the failures of individual probes are reported
+	if (port && !_strnicmp(port, "FAIL", 4))
+		return Fail(INITIALIZE_ERR);
+	*version = 3;
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Close(LONG vccOff)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Configure(LONG mode, LONG value)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_VCC(LONG voltage)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_OpenDevice(CHAR* Device, CHAR* Password, LONG PwLength, LONG DeviceCode, LONG setId)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_GetFoundDevice(CHAR* FoundDevice, LONG count)
+{
+	BeginCall(0);
+	DEVICE_T device;
+	memset(&device, 0, sizeof(device));
+	device.endian = 0xaa55;
+	device.id = 0xF169;
+	strcpy((char *)device.string, "MSP430F1611 (fake)");
+	device.mainStart = (WORD)s_MainStart;
+	device.mainEnd = s_MainEnd;
+	device.infoStart = INFO_START;
+	device.infoEnd = INFO_END;
+	device.ramStart = RAM_START;
+	device.ramEnd = RAM_END;
+	device.nBreakpoints = 3;
+	device.emulation = EMEX_MEDIUM;
+	device.mainSegmentSize = MAIN_SEGMENT_SIZE;
+
+	if ((size_t)count > sizeof(device))
+		count = sizeof(device);
+	memcpy(FoundDevice, &device, count);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Reset(LONG method, LONG execute, LONG releaseJTAG)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Erase(LONG type, LONG address, LONG length)
+{
+	unsigned erasedSegments;
+	switch(type)
+	{
+	case ERASE_SEGMENT:
+		erasedSegments = EraseSegments(address, address + (length ? length : 1) - 1);
+		break;
+	case ERASE_MAIN:
+		erasedSegments = EraseSegments(s_MainStart, s_MainEnd);
+		break;
+	case ERASE_ALL:
+	case ERASE_TOTAL:
+		erasedSegments = EraseSegments(INFO_START, INFO_END) + EraseSegments(s_MainStart, s_MainEnd);
+		break;
+	default:
+		return Fail(PARAMETER_ERR);
+	}
+
+	//Real devices erase the entire main FLASH in about the same time as a single segment
+	if (type != ERASE_SEGMENT)
+		erasedSegments = 1;
+
+	s_Stats.ErasedSegments += erasedSegments;
+	BeginCall(erasedSegments * s_Timing.SegmentEraseMicroseconds * 1000ULL);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Memory(LONG address, CHAR* buffer, LONG count, LONG rw)
+{
+	if (address < 0 || count < 0 || (address + count) > ADDRESS_SPACE_SIZE)
+		return Fail(PARAMETER_ERR);
+
+	if (rw == READ)
+	{
+		BeginCall((unsigned long long)count * s_Timing.ReadByteNanoseconds);
+		s_Stats.BytesRead += count;
+		memcpy(buffer, &s_Memory[address], count);
+		return STATUS_OK;
+	}
+
+	BeginCall((unsigned long long)count * s_Timing.WriteByteNanoseconds);
+	s_Stats.Writes++;
+	s_Stats.BytesWritten += count;
+	for (LONG i = 0; i < count; i++)
+	{
+		if (IsFLASH(address + i))
+			s_Memory[address + i] &= buffer[i];
+		else
+			s_Memory[address + i] = buffer[i];
+	}
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_VerifyMem(LONG StartAddr, LONG Length, CHAR* DataArray)
+{
+	if (StartAddr < 0 || Length < 0 || (StartAddr + Length) > ADDRESS_SPACE_SIZE)
+		return Fail(PARAMETER_ERR);
+
+	//The checksum is computed by the device, so the time does not depend on the length
+	BeginCall(0);
+	if (memcmp(&s_Memory[StartAddr], DataArray, Length))
+		return Fail(VERIFY_ERR);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Registers(LONG* registers, LONG mask, LONG rw)
+{
+	BeginCall(0);
+	for (int i = 0; i < 16; i++)
+	{
+		if (!(mask & (1 << i)))
+			continue;
+		if (rw == READ)
+			registers[i] = s_Registers[i];
+		else
+			s_Registers[i] = registers[i];
+	}
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_Register(LONG* reg, LONG regNb, LONG rw)
+{
+	if (regNb < 0 || regNb >= 16)
+		return Fail(PARAMETER_ERR);
+
+	BeginCall(0);
+	if (rw == READ)
+		*reg = s_Registers[regNb];
+	else
+		s_Registers[regNb] = *reg;
+	return STATUS_OK;
+}
+
+//The fake CPU stops immediately after it is started
+STATUS_T WINAPI MSP430_Run(LONG mode, LONG releaseJTAG)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_State(LONG* state, LONG stop, LONG* pCPUCycles)
+{
+	BeginCall(0);
+	*state = STOPPED;
+	if (pCPUCycles)
+		*pCPUCycles = 0;
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_EEM_Init(MSP430_EVENTNOTIFY_FUNC callback, LONG clientHandle, MessageID_t* pMsgIdBuffer)
+{
+	BeginCall(0);
+	return STATUS_OK;
+}
+
+STATUS_T WINAPI MSP430_EEM_SetBreakpoint(WORD* pwBpHandle, BpParameter_t* pBpBuffer)
+{
+	BeginCall(0);
+	if (pBpBuffer->bpMode != BP_CLEAR && !*pwBpHandle)
+		*pwBpHandle = s_NextBreakpointHandle++;
+	return STATUS_OK;
+}
+
+LONG WINAPI MSP430_Error_Number(void)
+{
+	return s_LastError;
+}
+
+const CHAR* WINAPI MSP430_Error_String(LONG errorNumber)
+{
+	switch(errorNumber)
+	{
+	case INITIALIZE_ERR:
+		return "Could not initialize device interface (fake probe)";
+	case VERIFY_ERR:
+		return "Verification error (fake probe)";
+	case PARAMETER_ERR:
+		return "Invalid parameter(s) (fake probe)";
+	default:
+		return "Fake MSP430 API error";
+	}
+}
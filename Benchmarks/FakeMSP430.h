@@ -0,0 +1,59 @@
+#pragma once
+
+//! Minimal replacement for the MSP430.DLL API used to benchmark the proxy without a FET probe
+/*! FakeMSP430.cpp implements the subset of the MSP430.DLL functions called by the proxy on top of a host-side memory array.
+	Each call waits for a configurable amount of time, so that the per-call and per-byte costs of a real USB FET can be modelled.
+	FLASH semantics are emulated: programming can only clear bits and erasing fills whole segments with 0xFF.
+
+	The benchmark drivers link this file directly and configure it using the functions below.
+	The FakeMSP430 project builds the same file as a drop-in replacement for MSP430.DLL, so that msp430-gdbproxy.exe itself
+	can be run without hardware (see GangBenchmark.bat). In that case the timing is read from the environment when
+	MSP430_Initialize() is called: FAKE_MSP430_CALL_US, FAKE_MSP430_WRITE_NS, FAKE_MSP430_READ_NS and FAKE_MSP430_ERASE_US.
+	MSP430_GetNumberOfUsbIfs() reports FAKE_MSP430_PROBES probes (default 1) named FAKE1, FAKE2, etc.
+	MSP430_Initialize() fails for the port names starting with "FAIL".
+*/
+namespace FakeMSP430
+{
+	struct Timing
+	{
+		unsigned CallMicroseconds;
+		unsigned WriteByteNanoseconds;
+		unsigned ReadByteNanoseconds;
+		unsigned SegmentEraseMicroseconds;
+
+		//! The default values roughly correspond to a FET430UIF programming an F1xx device
+		Timing()
+			: CallMicroseconds(1000)
+			, WriteByteNanoseconds(30000)
+			, ReadByteNanoseconds(2000)
+			, SegmentEraseMicroseconds(20000)
+		{
+		}
+	};
+
+	struct Statistics
+	{
+		unsigned Calls, Writes, ErasedSegments;
+		unsigned long long BytesRead, BytesWritten;
+		//! Total time spent inside the API calls
+		unsigned long long BusyMicroseconds;
+	};
+
+	void SetTiming(const Timing &timing);
+
+	//! Changes the main FLASH range reported by MSP430_GetFoundDevice() (default: 0x4000-0xFFFF, like MSP430F1611)
+	/*! The address space of the fake device is 1 MB, so mainEnd can be up to 0xFFFFF */
+	void SetMainFLASHRange(unsigned mainStart, unsigned mainEnd);
+
+	//! Fills the given range with pseudo-random data (e.g. to simulate a previously programmed firmware)
+	void FillMemory(unsigned start, unsigned end, unsigned seed);
+
+	//! Returns a pointer to the memory of the fake device (e.g. to check the programmed data)
+	const unsigned char *GetMemory();
+
+	//! Overwrites the memory of the fake device without an API call (e.g. to simulate the firmware reprogramming its own FLASH)
+	void SetMemory(unsigned addr, const void *pData, size_t length);
+
+	void ResetStatistics();
+	Statistics GetStatistics();
+}
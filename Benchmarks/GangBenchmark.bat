@@ -0,0 +1,36 @@
+@echo off
+rem Compares the gang programming time of 1 and N fake FET probes.
+rem Build the Release configuration of msp430-gdbproxy and FakeMSP430 first.
+rem Usage: GangBenchmark.bat <image file> [number of probes, default 8]
+rem The FAKE_MSP430_CALL_US, FAKE_MSP430_WRITE_NS, FAKE_MSP430_READ_NS and FAKE_MSP430_ERASE_US
+rem variables override the simulated FET timing (see FakeMSP430.h).
+
+setlocal
+if "%~1"=="" (
+	echo Usage: %~nx0 ^<image file^> [number of probes]
+	exit /b 1
+)
+
+set IMAGE=%~f1
+set PROBES=%~2
+if "%PROBES%"=="" set PROBES=8
+
+set BUILDDIR=%~dp0..\Release
+set RUNDIR=%TEMP%\msp430-gang-benchmark
+
+rem The fake DLL is copied next to a separate copy of the proxy, so that the real MSP430.DLL is not replaced
+if not exist "%RUNDIR%" mkdir "%RUNDIR%"
+copy /y "%BUILDDIR%\msp430-gdbproxy.exe" "%RUNDIR%" >nul || exit /b 1
+copy /y "%BUILDDIR%\FakeMSP430\MSP430.dll" "%RUNDIR%" >nul || exit /b 1
+
+echo ===== 1 probe =====
+set FAKE_MSP430_PROBES=1
+"%RUNDIR%\msp430-gdbproxy.exe" --program="%IMAGE%" --gang
+echo.
+echo ===== %PROBES% probes =====
+set FAKE_MSP430_PROBES=%PROBES%
+"%RUNDIR%\msp430-gdbproxy.exe" --program="%IMAGE%" --gang
+echo.
+echo ===== 2 probes, one failing =====
+"%RUNDIR%\msp430-gdbproxy.exe" --program="%IMAGE%" --gang=FAKE1,FAIL2
+exit /b 0
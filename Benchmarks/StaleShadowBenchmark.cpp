@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include "FakeMSP430.h"
+#include "SoftwareBreakpointManager.h"
+#include "TargetMemoryCache.h"
+
+using namespace MSP430Proxy;
+
+enum
+{
+	MAIN_SEGMENT_SIZE = 512,
+	BREAK_INSTRUCTION = 0x4343,
+	FLASH_START = 0x4000,
+	FLASH_END = 0xFFFF,
+	TEST_SEGMENT = 0x8000,
+	TEST_BREAKPOINT = TEST_SEGMENT + 0x10,
+};
+
+static unsigned short ReadDeviceWord(unsigned addr)
+{
+	const unsigned char *pMemory = FakeMSP430::GetMemory();
+	return (unsigned short)(pMemory[addr] | (pMemory[addr + 1] << 8));
+}
+
+static void WriteDeviceWord(unsigned addr, unsigned short value)
+{
+	unsigned char bytes[2] = {(unsigned char)value, (unsigned char)(value >> 8)};
+	FakeMSP430::SetMemory(addr, bytes, sizeof(bytes));
+}
+
+//Loads the test segment into the FLASH shadow while it contains shadowValue at the breakpoint address, then changes the device word to deviceValue.
+//Setting and removing the breakpoint should only change the breakpoint word, based on the device contents and not on the shadow.
+static bool CheckBreakpointCommit(const char *pDescription, unsigned short shadowValue, unsigned short deviceValue, unsigned expectedErases)
+{
+	FakeMSP430::SetMainFLASHRange(FLASH_START, FLASH_END);
+	FakeMSP430::FillMemory(FLASH_START, FLASH_END, 1);
+	WriteDeviceWord(TEST_BREAKPOINT, shadowValue);
+
+	TargetMemoryCache cache;
+	cache.AddRegion("main", FLASH_START, FLASH_END, rpCacheable | rpPrefetchable | rpImmutableWhileHalted | rpWriteThrough);
+	cache.EnableFLASHShadow(FLASH_START, FLASH_END, MAIN_SEGMENT_SIZE);
+
+	SoftwareBreakpointManager manager(FLASH_START, FLASH_END, BREAK_INSTRUCTION, &cache, NULL, true, false);
+
+	//gdb reads the code around the stop location, which loads it into the shadow
+	unsigned char segmentData[MAIN_SEGMENT_SIZE];
+	if (!cache.ReadMemory(TEST_SEGMENT, segmentData, sizeof(segmentData)))
+	{
+		printf("Failed to read the FLASH segment at 0x%x\n", TEST_SEGMENT);
+		return false;
+	}
+
+	WriteDeviceWord(TEST_BREAKPOINT, deviceValue);
+	unsigned char deviceContents[MAIN_SEGMENT_SIZE], expectedContents[MAIN_SEGMENT_SIZE];
+	memcpy(deviceContents, FakeMSP430::GetMemory() + TEST_SEGMENT, sizeof(deviceContents));
+	memcpy(expectedContents, deviceContents, sizeof(expectedContents));
+	expectedContents[TEST_BREAKPOINT - TEST_SEGMENT] = (unsigned char)BREAK_INSTRUCTION;
+	expectedContents[TEST_BREAKPOINT - TEST_SEGMENT + 1] = (unsigned char)(BREAK_INSTRUCTION >> 8);
+
+	FakeMSP430::ResetStatistics();
+	unsigned long long startTime = GetBenchmarkTime();
+	if (!manager.SetBreakpoint(TEST_BREAKPOINT) || !manager.CommitBreakpoints())
+	{
+		printf("%s: failed to set a breakpoint at 0x%x\n", pDescription, TEST_BREAKPOINT);
+		return false;
+	}
+	unsigned long long commitTime = GetBenchmarkTime() - startTime;
+	FakeMSP430::Statistics stats = FakeMSP430::GetStatistics();
+
+	printf("%-40s commit: %4d ms, %d segment erases, %5d bytes read, %5d bytes written\n", pDescription,
+		(unsigned)(commitTime / 1000), stats.ErasedSegments, (unsigned)stats.BytesRead, (unsigned)stats.BytesWritten);
+
+	if (memcmp(FakeMSP430::GetMemory() + TEST_SEGMENT, expectedContents, sizeof(expectedContents)))
+	{
+		printf("%s: the FLASH segment does not match the device contents with the breakpoint (0x%04x at 0x%x)\n", pDescription, ReadDeviceWord(TEST_BREAKPOINT), TEST_BREAKPOINT);
+		return false;
+	}
+
+	if (stats.ErasedSegments != expectedErases)
+	{
+		printf("%s: expected %d segment erases\n", pDescription, expectedErases);
+		return false;
+	}
+
+	//The original instruction saved by the commit is written back when the breakpoint is removed
+	if (!manager.RemoveBreakpoint(TEST_BREAKPOINT) || !manager.CommitBreakpoints())
+	{
+		printf("%s: failed to remove the breakpoint at 0x%x\n", pDescription, TEST_BREAKPOINT);
+		return false;
+	}
+
+	if (memcmp(FakeMSP430::GetMemory() + TEST_SEGMENT, deviceContents, sizeof(deviceContents)))
+	{
+		printf("%s: removing the breakpoint restored 0x%04x instead of 0x%04x\n", pDescription, ReadDeviceWord(TEST_BREAKPOINT), deviceValue);
+		return false;
+	}
+
+	return true;
+}
+
+int RunStaleShadowBenchmark( int argc, char *argv[] )
+{
+	if (argc)
+	{
+		printf("Unknown option: %s\n", argv[0]);
+		return 1;
+	}
+
+	//The default fake FET timing is used, so that the cost of detecting the stale contents can be compared with a normal commit
+	FakeMSP430::SetTiming(FakeMSP430::Timing());
+
+	if (!CheckBreakpointCommit("Shadow matches the device", 0xFFFF, 0xFFFF, 0))
+		return 1;
+	//Programming 0x4343 over 0x0000 would not change anything, so the segment has to be erased and rewritten from the device contents
+	if (!CheckBreakpointCommit("Stale shadow, breakpoint needs an erase", 0xFFFF, 0x0000, 1))
+		return 1;
+	//Programming 0x4343 over 0xFFFF succeeds, but the original instruction must be taken from the device and not from the shadow
+	if (!CheckBreakpointCommit("Stale shadow, no erase needed", 0x5B5B, 0xFFFF, 0))
+		return 1;
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+#include <string>
+
+struct BenchmarkRecord
+{
+	const char *pName;
+	const char *pDescription;
+	int (*pEntry)(int argc, char *argv[]);
+};
+
+static const BenchmarkRecord s_Benchmarks[] = {
+	{"pipeline", "FLASH load time with and without the JTAG worker pipeline\n\
+    --size=<n> - Image size in bytes (default 32768)\n\
+    --packet=<n> - vFlashWrite packet size (default 1024)\n\
+    --packet_us=<n> - Time gdb needs to send one packet (default 3000)\n\
+    --call_us=<n> --write_ns=<n> --erase_us=<n> - Fake FET timing", RunFLASHPipelineBenchmark},
+	{"breakpoints", "Software breakpoint commit time for different FLASH sizes\n\
+    --iterations=<n> - Number of commits per measurement (default 10000)", RunBreakpointCommitBenchmark},
+	{"snapshot", "Time needed to hide the software breakpoints in a memory snapshot of the entire FLASH\n\
+    --iterations=<n> - Number of snapshots per measurement (default 1000)", RunBreakpointSnapshotBenchmark},
+	{"staleshadow", "Breakpoint commits after the FLASH was modified behind the FLASH shadow. Fails if the wrong contents is programmed.", RunStaleShadowBenchmark},
+};
+
+bool ParseBenchmarkOption( const char *pArg, const char *pName, unsigned *pValue )
+{
+	std::string prefix = std::string("--") + pName + "=";
+	if (strncmp(pArg, prefix.c_str(), prefix.length()))
+		return false;
+	*pValue = strtoul(pArg + prefix.length(), NULL, 0);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	setbuf(stdout, NULL);
+	//Allows BenchmarkWait() to sleep with a millisecond resolution
+	timeBeginPeriod(1);
+
+	for (size_t i = 0; argc >= 2 && i < __countof(s_Benchmarks); i++)
+		if (!strcmp(argv[1], s_Benchmarks[i].pName))
+			return s_Benchmarks[i].pEntry(argc - 2, argv + 2);
+
+	printf("Usage: msp430-benchmarks <benchmark> [options]\nAvailable benchmarks:\n");
+	for (size_t i = 0; i < __countof(s_Benchmarks); i++)
+		printf("  %s - %s\n", s_Benchmarks[i].pName, s_Benchmarks[i].pDescription);
+	return 1;
+}
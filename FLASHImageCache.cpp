@@ -0,0 +1,79 @@
+#include "stdafx.h"
+#include "FLASHImageCache.h"
+#include "MSP430Util.h"
+
+using namespace MSP430Proxy;
+
+MSP430Proxy::FLASHImageCache::FLASHImageCache( const char *pDirectory, const char *pPortName, unsigned deviceID, unsigned jtagID, unsigned mainStart, unsigned mainEnd, unsigned segmentSize )
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+	m_Header.Signature = SIGNATURE;
+	m_Header.Version = VERSION;
+	m_Header.DeviceID = deviceID;
+	m_Header.JtagID = jtagID;
+	m_Header.MainStart = mainStart;
+	m_Header.MainEnd = mainEnd;
+	m_Header.SegmentSize = segmentSize;
+	m_Header.SegmentCount = GetFLASHSegmentCount(mainStart, mainEnd, segmentSize);
+
+	char szFileName[128];
+	_snprintf_s(szFileName, _TRUNCATE, "\\flash-%04x-%02x-%s.bin", deviceID, jtagID, GetPortNameForFileName(pPortName).c_str());
+	m_FileName = GetProxyDataDirectory(pDirectory) + szFileName;
+}
+
+bool MSP430Proxy::FLASHImageCache::Load( std::vector<unsigned char> &image, std::vector<bool> &validSegments )
+{
+	FILE *pFile = fopen(m_FileName.c_str(), "rb");
+	if (!pFile)
+		return false;
+
+	FileHeader header;
+	std::vector<SegmentHeader> segments(m_Header.SegmentCount);
+	image.resize(m_Header.MainEnd - m_Header.MainStart + 1);
+
+	bool succeeded = fread(&header, sizeof(header), 1, pFile) == 1 && !memcmp(&header, &m_Header, sizeof(header)) &&
+		fread(&segments[0], sizeof(SegmentHeader), segments.size(), pFile) == segments.size() &&
+		fread(&image[0], 1, image.size(), pFile) == image.size();
+	fclose(pFile);
+
+	if (!succeeded)
+		return false;
+
+	validSegments.assign(m_Header.SegmentCount, false);
+	for (unsigned i = 0; i < m_Header.SegmentCount; i++)
+	{
+		if (!segments[i].Valid)
+			continue;
+
+		size_t offset, end;
+		GetFLASHSegmentBounds(m_Header.MainStart, m_Header.MainEnd, m_Header.SegmentSize, i, &offset, &end);
+		validSegments[i] = UpdateCRC32(0xFFFFFFFF, &image[offset], end - offset) == segments[i].CRC;
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::FLASHImageCache::Save( const std::vector<unsigned char> &image, const std::vector<bool> &validSegments )
+{
+	if (image.size() != (m_Header.MainEnd - m_Header.MainStart + 1) || validSegments.size() != m_Header.SegmentCount)
+		return false;
+
+	std::vector<SegmentHeader> segments(m_Header.SegmentCount);
+	for (unsigned i = 0; i < m_Header.SegmentCount; i++)
+	{
+		size_t offset, end;
+		GetFLASHSegmentBounds(m_Header.MainStart, m_Header.MainEnd, m_Header.SegmentSize, i, &offset, &end);
+		segments[i].Valid = validSegments[i];
+		segments[i].CRC = validSegments[i] ? UpdateCRC32(0xFFFFFFFF, &image[offset], end - offset) : 0;
+	}
+
+	FILE *pFile = fopen(m_FileName.c_str(), "wb");
+	if (!pFile)
+		return false;
+
+	bool succeeded = fwrite(&m_Header, sizeof(m_Header), 1, pFile) == 1 &&
+		fwrite(&segments[0], sizeof(SegmentHeader), segments.size(), pFile) == segments.size() &&
+		fwrite(&image[0], 1, image.size(), pFile) == image.size();
+	fclose(pFile);
+	return succeeded;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace MSP430Proxy
+{
+	//! Stores the last known main FLASH contents of a device on disk
+	/*! When the proxy is restarted, the FLASH shadow is empty and the first load or disassembly has to read the entire FLASH
+		over JTAG. This class saves the FLASH shadow to a file named after the device ID, the JTAG ID and the FET port,
+		so that it can be restored on the next start after a single device-side verification.
+		Each segment is saved with its CRC-32, so that a damaged file only affects the damaged segments.
+	*/
+	class FLASHImageCache
+	{
+	private:
+		enum {SIGNATURE = 'IFPM', VERSION = 1};
+
+		struct FileHeader
+		{
+			unsigned Signature;
+			unsigned Version;
+			unsigned DeviceID, JtagID;
+			unsigned MainStart, MainEnd;
+			unsigned SegmentSize, SegmentCount;
+		};
+
+		struct SegmentHeader
+		{
+			unsigned Valid;
+			unsigned CRC;
+		};
+
+		std::string m_FileName;
+		FileHeader m_Header;
+
+	public:
+		//! Creates an image cache for the given device
+		/*!
+			\param pDirectory Specifies the directory containing the cache files. If it is empty, %LOCALAPPDATA%\\msp430-gdbproxy is used.
+		*/
+		FLASHImageCache(const char *pDirectory, const char *pPortName, unsigned deviceID, unsigned jtagID, unsigned mainStart, unsigned mainEnd, unsigned segmentSize);
+
+		//! Loads the saved image. Segments with a mismatching CRC are reported as invalid.
+		bool Load(std::vector<unsigned char> &image, std::vector<bool> &validSegments);
+		bool Save(const std::vector<unsigned char> &image, const std::vector<bool> &validSegments);
+
+		const char *GetFileName()
+		{
+			return m_FileName.c_str();
+		}
+	};
+}
@@ -0,0 +1,143 @@
+#include "stdafx.h"
+#include "FLASHWearCounter.h"
+#include "MSP430Util.h"
+#include <vector>
+#include <stddef.h>
+
+using namespace MSP430Proxy;
+
+MSP430Proxy::FLASHWearCounter::FLASHWearCounter( const char *pDirectory, const char *pPortName, unsigned deviceID, unsigned mainStart, unsigned mainEnd, unsigned mainSegmentSize, unsigned infoSegmentSize, unsigned warningThreshold )
+	: m_WarningThreshold(warningThreshold)
+	, m_bModified(false)
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+	m_Header.Signature = SIGNATURE;
+	m_Header.Version = VERSION;
+	m_Header.DeviceID = deviceID;
+	m_Header.MainStart = mainStart;
+	m_Header.MainEnd = mainEnd;
+	m_Header.MainSegmentSize = mainSegmentSize;
+	m_Header.InfoSegmentSize = infoSegmentSize;
+
+	char szFileName[128];
+	_snprintf_s(szFileName, _TRUNCATE, "\\wear-%04x-%s.bin", deviceID, GetPortNameForFileName(pPortName).c_str());
+	m_FileName = GetProxyDataDirectory(pDirectory) + szFileName;
+}
+
+MSP430Proxy::FLASHWearCounter::~FLASHWearCounter()
+{
+	SaveIfModified();
+}
+
+bool MSP430Proxy::FLASHWearCounter::Load()
+{
+	FILE *pFile = fopen(m_FileName.c_str(), "rb");
+	if (!pFile)
+		return false;
+
+	FileHeader header;
+	std::vector<Record> records;
+	bool succeeded = fread(&header, sizeof(header), 1, pFile) == 1 && !memcmp(&header, &m_Header, offsetof(FileHeader, RecordCount));
+	if (succeeded && header.RecordCount)
+	{
+		records.resize(header.RecordCount);
+		succeeded = fread(&records[0], sizeof(Record), records.size(), pFile) == records.size();
+	}
+	fclose(pFile);
+
+	if (!succeeded)
+		return false;
+
+	m_Counters.clear();
+	for (size_t i = 0; i < records.size(); i++)
+		m_Counters[records[i].SegmentBase] = records[i].EraseCount;
+	return true;
+}
+
+bool MSP430Proxy::FLASHWearCounter::Save()
+{
+	std::vector<Record> records;
+	for (CounterMap::iterator it = m_Counters.begin(); it != m_Counters.end(); it++)
+	{
+		Record record = {it->first, it->second};
+		records.push_back(record);
+	}
+
+	FileHeader header = m_Header;
+	header.RecordCount = (unsigned)records.size();
+
+	FILE *pFile = fopen(m_FileName.c_str(), "wb");
+	if (!pFile)
+		return false;
+
+	bool succeeded = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		(records.empty() || fwrite(&records[0], sizeof(Record), records.size(), pFile) == records.size());
+	fclose(pFile);
+
+	if (succeeded)
+		m_bModified = false;
+	return succeeded;
+}
+
+void MSP430Proxy::FLASHWearCounter::SaveIfModified()
+{
+	if (!m_bModified)
+		return;
+
+	if (!Save())
+	{
+		printf("Warning: cannot save FLASH erase counters to %s\n", m_FileName.c_str());
+		m_bModified = false;	//Do not repeat the warning after each operation
+	}
+}
+
+void MSP430Proxy::FLASHWearCounter::OnSegmentsErased( unsigned addr, size_t length )
+{
+	if (!length)
+		return;
+
+	unsigned end = (unsigned)(addr + length);
+	for (unsigned seg = addr & ~(GetSegmentSize(addr) - 1); seg < end; seg += GetSegmentSize(seg))
+	{
+		unsigned count = ++m_Counters[seg];
+		if (m_WarningThreshold && count == m_WarningThreshold)
+			printf("Warning: FLASH segment at 0x%x has been erased %d times. Consider using hardware breakpoints or --keepbp.\n", seg, count);
+	}
+
+	m_bModified = true;
+}
+
+void MSP430Proxy::FLASHWearCounter::Format( std::string &output )
+{
+	char szMsg[256];
+	_snprintf_s(szMsg, _TRUNCATE, "FLASH erase cycles (saved in %s):\n", m_FileName.c_str());
+	output = szMsg;
+
+	for (CounterMap::iterator it = m_Counters.begin(); it != m_Counters.end(); )
+	{
+		unsigned start = it->first, count = it->second;
+		unsigned end = start + GetSegmentSize(start);
+		for (it++; it != m_Counters.end() && it->first == end && it->second == count; it++)
+			end += GetSegmentSize(it->first);
+
+		_snprintf_s(szMsg, _TRUNCATE, "0x%05x-0x%05x: %d%s\n", start, end - 1, count, (m_WarningThreshold && count >= m_WarningThreshold) ? " (above the warning threshold)" : "");
+		output += szMsg;
+	}
+
+	if (m_Counters.empty())
+		output += "No segments have been erased yet\n";
+	else if (m_WarningThreshold)
+	{
+		_snprintf_s(szMsg, _TRUNCATE, "Maximum: %d erase cycles, warning threshold: %d\n", GetMaximumEraseCount(), m_WarningThreshold);
+		output += szMsg;
+	}
+}
+
+unsigned MSP430Proxy::FLASHWearCounter::GetMaximumEraseCount()
+{
+	unsigned result = 0;
+	for (CounterMap::iterator it = m_Counters.begin(); it != m_Counters.end(); it++)
+		if (it->second > result)
+			result = it->second;
+	return result;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <map>
+#include <string>
+
+namespace MSP430Proxy
+{
+	//! Counts the erase cycles of each FLASH segment and keeps the counters on disk
+	/*! FLASH segments only survive a limited number of erase cycles. Each erase issued by the proxy (vFlashErase, "mon erase",
+		--autoerase and software breakpoints) is reported to OnSegmentsErased(). The counters are saved to a file named after
+		the device ID and the FET port by SaveIfModified() once per FLASH load, breakpoint commit or mass erase (and when the object
+		is destroyed), so they are preserved between debugging sessions without adding disk I/O to each segment erase.
+		Boards of the same type connected to different probes (e.g. in the --gang mode) are counted separately.
+		When the counter of a segment reaches the warning threshold, a warning is printed.
+	*/
+	class FLASHWearCounter
+	{
+	private:
+		enum {SIGNATURE = 'WFPM', VERSION = 2};
+
+		struct FileHeader
+		{
+			unsigned Signature;
+			unsigned Version;
+			unsigned DeviceID;
+			unsigned MainStart, MainEnd, MainSegmentSize;
+			unsigned InfoSegmentSize;
+			unsigned RecordCount;
+		};
+
+		struct Record
+		{
+			unsigned SegmentBase;
+			unsigned EraseCount;
+		};
+
+		//! Maps the segment base address to the amount of erase cycles
+		typedef std::map<unsigned, unsigned> CounterMap;
+		CounterMap m_Counters;
+
+		std::string m_FileName;
+		FileHeader m_Header;
+		unsigned m_WarningThreshold;
+		bool m_bModified;
+
+	private:
+		unsigned GetSegmentSize(unsigned addr)
+		{
+			return (addr >= m_Header.MainStart && addr <= m_Header.MainEnd) ? m_Header.MainSegmentSize : m_Header.InfoSegmentSize;
+		}
+
+	public:
+		//! Creates a wear counter for the given device
+		/*!
+			\param pDirectory Specifies the directory containing the counter files. If it is empty, %LOCALAPPDATA%\\msp430-gdbproxy is used.
+			\param pPortName Specifies the FET port. It is a part of the file name, so each probe keeps the counters of its own board.
+			\param warningThreshold Specifies the amount of erase cycles after which a warning is shown. 0 disables the warnings.
+			\param infoSegmentSize Specifies the segment size used for the addresses outside the main FLASH (i.e. information memory).
+		*/
+		FLASHWearCounter(const char *pDirectory, const char *pPortName, unsigned deviceID, unsigned mainStart, unsigned mainEnd, unsigned mainSegmentSize, unsigned infoSegmentSize, unsigned warningThreshold);
+		~FLASHWearCounter();
+
+		bool Load();
+		bool Save();
+
+		//! Saves the counters if they were changed since the last Save() call
+		void SaveIfModified();
+
+		//! Increments the counters of all segments overlapping the given range. The counters are saved by SaveIfModified().
+		void OnSegmentsErased(unsigned addr, size_t length);
+
+		//! Formats the counters as a table, merging consecutive segments with equal counters
+		void Format(std::string &output);
+
+		unsigned GetMaximumEraseCount();
+
+		const char *GetFileName()
+		{
+			return m_FileName.c_str();
+		}
+	};
+}
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "FLASHWriteBuffer.h"
+
+using namespace MSP430Proxy;
+
+void MSP430Proxy::FLASHWriteBuffer::Write( unsigned addr, const void *pData, size_t length )
+{
+	m_BufferedBytes += length;
+	for (size_t done = 0; done < length; )
+	{
+		unsigned segBase = (unsigned)(addr + done) & ~(SEGMENT_SIZE - 1);
+		unsigned offset = (unsigned)(addr + done) - segBase;
+		size_t todo = SEGMENT_SIZE - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		Segment &segment = m_Segments[segBase];
+		memcpy(segment.Data + offset, (const char *)pData + done, todo);
+		for (size_t i = 0; i < todo; i++)
+			segment.Written.set(offset + i);
+
+		done += todo;
+	}
+}
+
+void MSP430Proxy::FLASHWriteBuffer::GetMergedRuns( std::vector<Run> &runs )
+{
+	runs.clear();
+	for (SegmentMap::iterator it = m_Segments.begin(); it != m_Segments.end(); it++)
+		AppendSegmentRuns(it->first, it->second, runs);
+}
+
+void MSP430Proxy::FLASHWriteBuffer::AppendSegmentRuns( unsigned segmentBase, const Segment &segment, std::vector<Run> &runs )
+{
+	for (unsigned i = 0; i < SEGMENT_SIZE; i++)
+	{
+		if (!segment.Written[i])
+			continue;
+
+		unsigned addr = segmentBase + i;
+		if (runs.empty() || (runs.back().Start + runs.back().Data.size()) != addr)
+		{
+			runs.push_back(Run());
+			runs.back().Start = addr;
+		}
+
+		runs.back().Data.push_back(segment.Data[i]);
+	}
+}
+
+void MSP430Proxy::FLASHWriteBuffer::TakeSegmentsBelow( unsigned addr, SegmentMap &segments )
+{
+	segments.clear();
+	SegmentMap::iterator end = m_Segments.lower_bound(addr & ~(SEGMENT_SIZE - 1));
+	segments.insert(m_Segments.begin(), end);
+	m_Segments.erase(m_Segments.begin(), end);
+}
+
+void MSP430Proxy::FLASHWriteBuffer::Discard( unsigned addr, size_t length )
+{
+	for (size_t done = 0; done < length; )
+	{
+		unsigned segBase = (unsigned)(addr + done) & ~(SEGMENT_SIZE - 1);
+		unsigned offset = (unsigned)(addr + done) - segBase;
+		size_t todo = SEGMENT_SIZE - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		SegmentMap::iterator it = m_Segments.find(segBase);
+		if (it != m_Segments.end())
+		{
+			for (size_t i = 0; i < todo; i++)
+				it->second.Written.reset(offset + i);
+			if (it->second.Written.none())
+				m_Segments.erase(it);
+		}
+
+		done += todo;
+	}
+}
+
+void MSP430Proxy::FLASHWriteBuffer::ApplyToSegment( unsigned segmentBase, unsigned char *pData, size_t length )
+{
+	SegmentMap::iterator it = m_Segments.find(segmentBase);
+	if (it == m_Segments.end())
+		return;
+
+	if (length > SEGMENT_SIZE)
+		length = SEGMENT_SIZE;
+
+	for (size_t i = 0; i < length; i++)
+		if (it->second.Written[i])
+			pData[i] = it->second.Data[i];
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <bitset>
+
+namespace MSP430Proxy
+{
+	//! Collects the data sent by gdb in vFlashWrite packets until vFlashDone is received
+	/*! gdb splits the loaded image into small packets. Programming each of them with a separate MSP430_Write_Memory() call
+		makes the load time depend on the per-call JTAG overhead rather than on the FLASH programming speed. This class keeps
+		the written data in host-side segment buffers, so that it can be programmed as a few large contiguous runs when the
+		load is committed.
+	*/
+	class FLASHWriteBuffer
+	{
+	public:
+		enum {SEGMENT_SIZE = 512};
+
+		struct Run
+		{
+			unsigned Start;
+			std::vector<unsigned char> Data;
+		};
+
+		struct Segment
+		{
+			unsigned char Data[SEGMENT_SIZE];
+			std::bitset<SEGMENT_SIZE> Written;
+		};
+
+		typedef std::map<unsigned, Segment> SegmentMap;
+
+	private:
+		SegmentMap m_Segments;
+		size_t m_BufferedBytes;
+
+	public:
+		FLASHWriteBuffer()
+			: m_BufferedBytes(0)
+		{
+		}
+
+		void Write(unsigned addr, const void *pData, size_t length);
+
+		//! Returns the buffered data as a sorted list of maximal contiguous runs
+		void GetMergedRuns(std::vector<Run> &runs);
+
+		//! Appends the written bytes of a segment to the list of runs, extending the last run if it ends right before them
+		static void AppendSegmentRuns(unsigned segmentBase, const Segment &segment, std::vector<Run> &runs);
+
+		//! Removes the segments located entirely below the given address from the buffer and returns them
+		/*! gdb sends the vFlashWrite packets in the ascending address order, so such segments will not be written anymore */
+		void TakeSegmentsBelow(unsigned addr, SegmentMap &segments);
+
+		//! Copies the buffered bytes of the given segment over the contents of pData. Bytes that were not written are left unchanged.
+		void ApplyToSegment(unsigned segmentBase, unsigned char *pData, size_t length);
+
+		//! Drops the buffered data for the given range (e.g. when the device already contains it)
+		void Discard(unsigned addr, size_t length);
+
+		void Clear()
+		{
+			m_Segments.clear();
+			m_BufferedBytes = 0;
+		}
+
+		bool IsEmpty()
+		{
+			return m_Segments.empty();
+		}
+
+		//! Returns the total amount of bytes received via Write(), including the overwritten ones
+		size_t GetBufferedByteCount()
+		{
+			return m_BufferedBytes;
+		}
+	};
+}
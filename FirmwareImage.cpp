@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "FirmwareImage.h"
+#include <algorithm>
+
+using namespace MSP430Proxy;
+
+namespace
+{
+	struct ELFHeader
+	{
+		unsigned char Ident[16];
+		unsigned short Type, Machine;
+		unsigned Version, Entry, PhOff, ShOff, Flags;
+		unsigned short EhSize, PhEntSize, PhNum, ShEntSize, ShNum, ShStrNdx;
+	};
+
+	struct ELFProgramHeader
+	{
+		unsigned Type, Offset, VAddr, PAddr, FileSize, MemSize, Flags, Align;
+	};
+
+	enum {PT_LOAD = 1, ELFCLASS32 = 1, ELFDATA2LSB = 1};
+}
+
+static bool CompareSectionStart(const FirmwareImage::Section &left, const FirmwareImage::Section &right)
+{
+	return left.Start < right.Start;
+}
+
+static int ParseHexDigit(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	return -1;
+}
+
+void MSP430Proxy::FirmwareImage::AddData( unsigned addr, const void *pData, size_t length )
+{
+	if (!length)
+		return;
+
+	if (!m_Sections.empty() && (m_Sections.back().Start + m_Sections.back().Data.size()) == addr)
+	{
+		m_Sections.back().Data.insert(m_Sections.back().Data.end(), (const unsigned char *)pData, (const unsigned char *)pData + length);
+		return;
+	}
+
+	Section section;
+	section.Start = addr;
+	section.Data.assign((const unsigned char *)pData, (const unsigned char *)pData + length);
+	m_Sections.push_back(section);
+}
+
+void MSP430Proxy::FirmwareImage::MergeSections()
+{
+	std::stable_sort(m_Sections.begin(), m_Sections.end(), CompareSectionStart);
+
+	std::vector<Section> merged;
+	for (size_t i = 0; i < m_Sections.size(); i++)
+	{
+		const Section &section = m_Sections[i];
+		if (!merged.empty())
+		{
+			Section &last = merged.back();
+			unsigned lastEnd = (unsigned)(last.Start + last.Data.size());
+			if (section.Start <= lastEnd)
+			{
+				//Overlapping data from later records overrides the earlier one
+				unsigned sectionEnd = (unsigned)(section.Start + section.Data.size());
+				if (sectionEnd > lastEnd)
+					last.Data.resize(sectionEnd - last.Start);
+				std::copy(section.Data.begin(), section.Data.end(), last.Data.begin() + (section.Start - last.Start));
+				continue;
+			}
+		}
+		merged.push_back(section);
+	}
+
+	m_Sections.swap(merged);
+}
+
+bool MSP430Proxy::FirmwareImage::ParseELF( const std::vector<unsigned char> &file )
+{
+	if (file.size() < sizeof(ELFHeader))
+		return false;
+
+	const ELFHeader *pHeader = (const ELFHeader *)&file[0];
+	if (pHeader->Ident[4] != ELFCLASS32 || pHeader->Ident[5] != ELFDATA2LSB)
+	{
+		printf("Only 32-bit little-endian ELF files are supported\n");
+		return false;
+	}
+
+	//The offsets are checked against the file size before adding the lengths, so the checks cannot overflow with a 32-bit size_t
+	if (pHeader->PhEntSize < sizeof(ELFProgramHeader) || pHeader->PhOff > file.size() || ((size_t)pHeader->PhNum * pHeader->PhEntSize) > (file.size() - pHeader->PhOff))
+		return false;
+
+	for (unsigned i = 0; i < pHeader->PhNum; i++)
+	{
+		const ELFProgramHeader *pSegment = (const ELFProgramHeader *)&file[pHeader->PhOff + i * pHeader->PhEntSize];
+		if (pSegment->Type != PT_LOAD || !pSegment->FileSize)
+			continue;
+
+		if (pSegment->Offset > file.size() || pSegment->FileSize > (file.size() - pSegment->Offset))
+			return false;
+
+		AddData(pSegment->PAddr, &file[pSegment->Offset], pSegment->FileSize);
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::FirmwareImage::ParseIntelHex( const std::vector<unsigned char> &file )
+{
+	unsigned baseAddress = 0;
+	unsigned lineNumber = 0;
+	for (size_t pos = 0; pos < file.size(); )
+	{
+		size_t lineEnd = pos;
+		while (lineEnd < file.size() && file[lineEnd] != '\n')
+			lineEnd++;
+
+		std::string line((const char *)&file[pos], lineEnd - pos);
+		pos = lineEnd + 1;
+		lineNumber++;
+
+		while (!line.empty() && isspace((unsigned char)line[line.length() - 1]))
+			line.erase(line.length() - 1);
+		if (line.empty())
+			continue;
+
+		std::vector<unsigned char> record;
+		bool valid = line[0] == ':' && (line.length() & 1);
+		for (size_t i = 1; valid && i < line.length(); i += 2)
+		{
+			int high = ParseHexDigit(line[i]), low = ParseHexDigit(line[i + 1]);
+			valid = high >= 0 && low >= 0;
+			record.push_back((unsigned char)((high << 4) | low));
+		}
+
+		unsigned char checksum = 0;
+		for (size_t i = 0; i < record.size(); i++)
+			checksum += record[i];
+
+		if (!valid || record.size() < 5 || record.size() != (record[0] + 5u) || checksum)
+		{
+			printf("Invalid Intel HEX record in line %d\n", lineNumber);
+			return false;
+		}
+
+		//record[0] is the data length. The address records must contain exactly 2 data bytes and the data must end before the checksum byte.
+		unsigned offset = (record[1] << 8) | record[2];
+		unsigned char dataLength = record[0];
+		if ((record[3] == 0x02 || record[3] == 0x04) && dataLength != 2)
+		{
+			printf("Invalid Intel HEX address record in line %d\n", lineNumber);
+			return false;
+		}
+
+		switch (record[3])
+		{
+		case 0x00:
+			if ((4 + (size_t)dataLength) < record.size())
+				AddData(baseAddress + offset, &record[4], dataLength);
+			break;
+		case 0x01:
+			return true;
+		case 0x02:
+			baseAddress = ((record[4] << 8) | record[5]) << 4;
+			break;
+		case 0x04:
+			baseAddress = ((record[4] << 8) | record[5]) << 16;
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::FirmwareImage::ParseTIText( const std::vector<unsigned char> &file )
+{
+	unsigned addr = 0;
+	bool addressSet = false;
+	std::vector<unsigned char> data;
+
+	for (size_t pos = 0; pos < file.size(); )
+	{
+		char ch = file[pos];
+		if (isspace((unsigned char)ch))
+		{
+			pos++;
+			continue;
+		}
+
+		if (ch == 'q' || ch == 'Q')
+			break;
+
+		if (ch == '@')
+		{
+			AddData(addr, data.empty() ? NULL : &data[0], data.size());
+			data.clear();
+
+			addr = 0;
+			for (pos++; pos < file.size() && ParseHexDigit(file[pos]) >= 0; pos++)
+				addr = (addr << 4) | ParseHexDigit(file[pos]);
+			addressSet = true;
+			continue;
+		}
+
+		if (!addressSet || (pos + 1) >= file.size() || ParseHexDigit(ch) < 0 || ParseHexDigit(file[pos + 1]) < 0)
+		{
+			printf("Invalid TI-TXT data at offset %d\n", pos);
+			return false;
+		}
+
+		data.push_back((unsigned char)((ParseHexDigit(ch) << 4) | ParseHexDigit(file[pos + 1])));
+		pos += 2;
+	}
+
+	AddData(addr, data.empty() ? NULL : &data[0], data.size());
+	return true;
+}
+
+bool MSP430Proxy::FirmwareImage::ParseSectionDump( const std::vector<unsigned char> &file )
+{
+	const DumpHeader *pHeader = (const DumpHeader *)&file[0];
+	if (pHeader->Version != VERSION)
+	{
+		printf("Unsupported section dump version: %d\n", pHeader->Version);
+		return false;
+	}
+
+	size_t offset = sizeof(DumpHeader);
+	for (unsigned i = 0; i < pHeader->SectionCount; i++)
+	{
+		if (sizeof(DumpSectionHeader) > (file.size() - offset))
+			return false;
+		const DumpSectionHeader *pSection = (const DumpSectionHeader *)&file[offset];
+		offset += sizeof(DumpSectionHeader);
+
+		if (pSection->Length > (file.size() - offset))
+			return false;
+		AddData(pSection->Start, pSection->Length ? &file[offset] : NULL, pSection->Length);
+		offset += pSection->Length;
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::FirmwareImage::Load( const char *pFileName )
+{
+	m_Sections.clear();
+
+	FILE *pFile = fopen(pFileName, "rb");
+	if (!pFile)
+	{
+		printf("Cannot open %s\n", pFileName);
+		return false;
+	}
+
+	std::vector<unsigned char> file;
+	unsigned char buffer[4096];
+	for (;;)
+	{
+		size_t done = fread(buffer, 1, sizeof(buffer), pFile);
+		if (!done)
+			break;
+		file.insert(file.end(), buffer, buffer + done);
+	}
+	fclose(pFile);
+
+	size_t firstChar = 0;
+	while (firstChar < file.size() && isspace(file[firstChar]))
+		firstChar++;
+
+	bool parsed;
+	if (file.size() >= sizeof(DumpHeader) && ((const DumpHeader *)&file[0])->Signature == SIGNATURE)
+		parsed = ParseSectionDump(file);
+	else if (file.size() >= 4 && !memcmp(&file[0], "\x7F" "ELF", 4))
+		parsed = ParseELF(file);
+	else if (firstChar < file.size() && file[firstChar] == ':')
+		parsed = ParseIntelHex(file);
+	else if (firstChar < file.size() && file[firstChar] == '@')
+		parsed = ParseTIText(file);
+	else
+	{
+		printf("Unknown file format: %s. Please specify an ELF, Intel HEX or TI-TXT file.\n", pFileName);
+		return false;
+	}
+
+	if (!parsed)
+	{
+		printf("Cannot parse %s\n", pFileName);
+		return false;
+	}
+
+	MergeSections();
+	if (m_Sections.empty())
+	{
+		printf("%s does not contain any data to program\n", pFileName);
+		return false;
+	}
+	return true;
+}
+
+size_t MSP430Proxy::FirmwareImage::GetTotalSize()
+{
+	size_t total = 0;
+	for (size_t i = 0; i < m_Sections.size(); i++)
+		total += m_Sections[i].Data.size();
+	return total;
+}
+
+bool MSP430Proxy::FirmwareImage::SaveSectionDump( const char *pFileName )
+{
+	FILE *pFile = fopen(pFileName, "wb");
+	if (!pFile)
+		return false;
+
+	DumpHeader header = {SIGNATURE, VERSION, (unsigned)m_Sections.size()};
+	bool succeeded = fwrite(&header, sizeof(header), 1, pFile) == 1;
+
+	for (size_t i = 0; succeeded && i < m_Sections.size(); i++)
+	{
+		const Section &section = m_Sections[i];
+		DumpSectionHeader sectionHeader = {section.Start, (unsigned)section.Data.size()};
+		succeeded = fwrite(&sectionHeader, sizeof(sectionHeader), 1, pFile) == 1 &&
+			(section.Data.empty() || fwrite(&section.Data[0], 1, section.Data.size(), pFile) == section.Data.size());
+	}
+
+	fclose(pFile);
+	return succeeded;
+}
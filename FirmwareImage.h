@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace MSP430Proxy
+{
+	//! Contains the memory contents of a firmware file that should be programmed into the device
+	/*! The following formats are supported:
+		- ELF files (the PT_LOAD segments are placed at their physical addresses)
+		- Intel HEX files
+		- TI-TXT files (produced by the TI tools and srec_cat)
+		- Section dumps produced by SaveSectionDump()
+		The format is detected from the file contents. Adjacent data is merged into sections sorted by address.
+	*/
+	class FirmwareImage
+	{
+	public:
+		struct Section
+		{
+			unsigned Start;
+			std::vector<unsigned char> Data;
+		};
+
+	private:
+		enum {SIGNATURE = 'SFPM', VERSION = 1};
+
+		struct DumpHeader
+		{
+			unsigned Signature;
+			unsigned Version;
+			unsigned SectionCount;
+		};
+
+		struct DumpSectionHeader
+		{
+			unsigned Start;
+			unsigned Length;
+		};
+
+		std::vector<Section> m_Sections;
+
+	private:
+		void AddData(unsigned addr, const void *pData, size_t length);
+		void MergeSections();
+
+		bool ParseELF(const std::vector<unsigned char> &file);
+		bool ParseIntelHex(const std::vector<unsigned char> &file);
+		bool ParseTIText(const std::vector<unsigned char> &file);
+		bool ParseSectionDump(const std::vector<unsigned char> &file);
+
+	public:
+		//! Loads the given file. Prints the error and returns false if the file cannot be parsed.
+		bool Load(const char *pFileName);
+
+		//! Saves the sections in a binary format that Load() reads without parsing (used to pass an image to the --gang child processes)
+		bool SaveSectionDump(const char *pFileName);
+
+		const std::vector<Section> &GetSections()
+		{
+			return m_Sections;
+		}
+
+		size_t GetTotalSize();
+	};
+}
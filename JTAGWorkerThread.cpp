@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include "JTAGWorkerThread.h"
+
+using namespace BazisLib;
+using namespace MSP430Proxy;
+
+MSP430Proxy::JTAGWorkerThread::JTAGWorkerThread()
+	: m_PendingJobs(0)
+	, m_bFailed(false)
+	, m_bTerminating(false)
+{
+	m_hThread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+}
+
+MSP430Proxy::JTAGWorkerThread::~JTAGWorkerThread()
+{
+	WaitForCompletion();
+	{
+		MutexLocker lck(m_Mutex);
+		m_bTerminating = true;
+	}
+	m_JobQueued.Signal();
+
+	if (m_hThread)
+	{
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+	}
+}
+
+DWORD CALLBACK MSP430Proxy::JTAGWorkerThread::ThreadProc( LPVOID lpParameter )
+{
+	((JTAGWorkerThread *)lpParameter)->ThreadBody();
+	return 0;
+}
+
+void MSP430Proxy::JTAGWorkerThread::ThreadBody()
+{
+	for (;;)
+	{
+		WaitForSingleObject(m_JobQueued.GetHandle(), INFINITE);
+
+		IJob *pJob = NULL;
+		bool skip;
+		{
+			MutexLocker lck(m_Mutex);
+			if (m_Queue.empty())
+			{
+				if (m_bTerminating)
+					return;
+				continue;
+			}
+
+			pJob = m_Queue.front();
+			m_Queue.pop_front();
+			skip = m_bFailed;
+		}
+
+		bool succeeded = skip || pJob->Run();
+		delete pJob;
+
+		{
+			MutexLocker lck(m_Mutex);
+			if (!succeeded)
+				m_bFailed = true;
+			m_PendingJobs--;
+		}
+		m_JobDone.Signal();
+	}
+}
+
+void MSP430Proxy::JTAGWorkerThread::Submit( IJob *pJob )
+{
+	if (!m_hThread)
+	{
+		//The thread could not be created, so the job is run synchronously
+		bool succeeded = pJob->Run();
+		delete pJob;
+		if (!succeeded)
+		{
+			MutexLocker lck(m_Mutex);
+			m_bFailed = true;
+		}
+		return;
+	}
+
+	{
+		MutexLocker lck(m_Mutex);
+		m_Queue.push_back(pJob);
+		m_PendingJobs++;
+	}
+	m_JobQueued.Signal();
+}
+
+bool MSP430Proxy::JTAGWorkerThread::WaitForCompletion()
+{
+	for (;;)
+	{
+		{
+			MutexLocker lck(m_Mutex);
+			if (!m_PendingJobs)
+			{
+				bool succeeded = !m_bFailed;
+				m_bFailed = false;
+				return succeeded;
+			}
+		}
+
+		WaitForSingleObject(m_JobDone.GetHandle(), INFINITE);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <bzscore/sync.h>
+#include <list>
+
+namespace MSP430Proxy
+{
+	//! Runs JTAG operations on a dedicated thread, so that they overlap with receiving the next gdb packets
+	/*! The jobs are executed in the order they were submitted. Once a job fails, the remaining queued jobs are discarded
+		and the failure is reported by the next WaitForCompletion() call.
+		\remarks While the worker has pending jobs, no other thread should call the MSP430 API. See MSP430GDBTarget::WaitForFLASHPipeline().
+	*/
+	class JTAGWorkerThread
+	{
+	public:
+		class IJob
+		{
+		public:
+			virtual bool Run() = 0;
+			virtual ~IJob() {}
+		};
+
+	private:
+		HANDLE m_hThread;
+		BazisLib::Mutex m_Mutex;
+		BazisLib::Semaphore m_JobQueued, m_JobDone;
+		std::list<IJob *> m_Queue;
+		unsigned m_PendingJobs;
+		bool m_bFailed, m_bTerminating;
+
+	private:
+		static DWORD CALLBACK ThreadProc(LPVOID lpParameter);
+		void ThreadBody();
+
+	public:
+		JTAGWorkerThread();
+		~JTAGWorkerThread();
+
+		//! Queues a job. The worker thread deletes the job after running it.
+		void Submit(IJob *pJob);
+
+		//! Waits until all submitted jobs are completed. Returns false if any of them has failed since the previous call.
+		bool WaitForCompletion();
+
+		bool HasFailed()
+		{
+			BazisLib::MutexLocker lck(m_Mutex);
+			return m_bFailed;
+		}
+
+		bool IsIdle()
+		{
+			BazisLib::MutexLocker lck(m_Mutex);
+			return !m_PendingJobs;
+		}
+	};
+}
@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "MSP430Stub.h"
+
+using namespace BazisLib;
+using namespace GDBServerFoundation;
+using namespace MSP430Proxy;
+
+//Binary data in gdb packets has '#', '$', '}' and '*' escaped as 0x7d followed by the original byte XORed with 0x20
+static void UnescapeBinaryData(const char *pData, size_t length, std::string &result)
+{
+	result.clear();
+	for (size_t i = 0; i < length; i++)
+	{
+		if (pData[i] == 0x7d && (i + 1) < length)
+			result += (char)(pData[++i] ^ 0x20);
+		else
+			result += pData[i];
+	}
+}
+
+StubResponse MSP430Proxy::MSP430Stub::HandleSearchMemory( const std::string &args )
+{
+	//Format: <address>;<length>;<binary pattern>
+	size_t sep1 = args.find(';');
+	size_t sep2 = (sep1 == std::string::npos) ? std::string::npos : args.find(';', sep1 + 1);
+	if (sep2 == std::string::npos)
+		return StubResponse("E01");
+
+	ULONGLONG addr = _strtoui64(args.c_str(), NULL, 16);
+	size_t length = strtoul(args.c_str() + sep1 + 1, NULL, 16);
+	std::string pattern;
+	UnescapeBinaryData(args.c_str() + sep2 + 1, args.length() - sep2 - 1, pattern);
+
+	ULONGLONG foundAddr = -1;
+	if (m_pTarget->SearchTargetMemory(addr, length, pattern.c_str(), pattern.length(), &foundAddr) != kGDBSuccess)
+		return StubResponse("E01");
+
+	if (foundAddr == -1)
+		return StubResponse("0");
+
+	char szResponse[32];
+	_snprintf_s(szResponse, _TRUNCATE, "1,%I64x", foundAddr);
+	return StubResponse(szResponse);
+}
+
+StubResponse MSP430Proxy::MSP430Stub::HandleCRC( const std::string &args )
+{
+	//Format: <address>,<length>
+	size_t sep = args.find(',');
+	if (sep == std::string::npos)
+		return StubResponse("E01");
+
+	ULONGLONG addr = _strtoui64(args.c_str(), NULL, 16);
+	size_t length = strtoul(args.c_str() + sep + 1, NULL, 16);
+
+	unsigned crc = 0;
+	if (m_pTarget->ComputeTargetMemoryCRC(addr, length, &crc) != kGDBSuccess)
+		return StubResponse("E01");
+
+	char szResponse[32];
+	_snprintf_s(szResponse, _TRUNCATE, "C%x", crc);
+	return StubResponse(szResponse);
+}
+
+StubResponse MSP430Proxy::MSP430Stub::HandleRequest( const BazisLib::TempStringA &requestType, char splitterChar, const BazisLib::TempStringA &requestData )
+{
+	std::string request(requestType.GetConstBuffer(), requestType.length());
+	if (splitterChar)
+		request += splitterChar;
+	request.append(requestData.GetConstBuffer(), requestData.length());
+
+	//vFlashWrite packets are the only ones that may be handled while the JTAG worker is still programming the previous segments
+	static const char flashWritePrefix[] = "vFlashWrite:";
+	if (request.compare(0, sizeof(flashWritePrefix) - 1, flashWritePrefix))
+		m_pTarget->WaitForFLASHPipeline();
+
+	//gdb sends nothing but vFlashErase, vFlashWrite and vFlashDone packets during a load, so any other packet means that it was aborted
+	static const char flashPrefix[] = "vFlash";
+	if (request.compare(0, sizeof(flashPrefix) - 1, flashPrefix))
+		m_pTarget->DiscardUnfinishedFLASHLoad();
+
+	static const char searchMemoryPrefix[] = "qSearch:memory:";
+	if (!request.compare(0, sizeof(searchMemoryPrefix) - 1, searchMemoryPrefix))
+		return HandleSearchMemory(request.substr(sizeof(searchMemoryPrefix) - 1));
+
+	static const char crcPrefix[] = "qCRC:";
+	if (!request.compare(0, sizeof(crcPrefix) - 1, crcPrefix))
+		return HandleCRC(request.substr(sizeof(crcPrefix) - 1));
+
+	return __super::HandleRequest(requestType, splitterChar, requestData);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "GDBServerFoundation/GDBStub.h"
+#include "MSP430Target.h"
+
+namespace MSP430Proxy
+{
+	//! Extends the generic GDB stub with the packets that are handled on the proxy side to reduce the JTAG traffic
+	/*! The following packets are supported:
+		- qSearch:memory (gdb "find" command). Without it gdb searches the memory using small 'm' packets.
+		- qCRC ("compare-sections" command). Without it gdb reads back every section.
+	*/
+	class MSP430Stub : public GDBStub
+	{
+	private:
+		MSP430GDBTarget *m_pTarget;
+
+	private:
+		StubResponse HandleSearchMemory(const std::string &args);
+		StubResponse HandleCRC(const std::string &args);
+
+	protected:
+		virtual StubResponse HandleRequest(const BazisLib::TempStringA &requestType, char splitterChar, const BazisLib::TempStringA &requestData);
+
+	public:
+		MSP430Stub(MSP430GDBTarget *pTarget)
+			: GDBStub(pTarget)
+			, m_pTarget(pTarget)
+		{
+		}
+	};
+}
@@ -1,390 +1,1316 @@
-#include "stdafx.h"
-#include "MSP430Target.h"
-#include "MSP430Util.h"
-
-using namespace GDBServerFoundation;
-using namespace MSP430Proxy;
-
-#define REPORT_AND_RETURN(msg, result) { ReportLastMSP430Error(msg); return result; }
-#define MAIN_SEGMENT_SIZE 512
-
-bool MSP430Proxy::MSP430GDBTarget::Initialize(const GlobalSettings &settings)
-{
-	if (m_bClosePending)
-		return m_bValid;
-
-	m_bVerbose = settings.Verbose;
-
-	LONG version = 0;
-	if (MSP430_Initialize((char *)settings.PortName, &version) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot initialize MSP430.DLL", false);
-	m_bClosePending = true;
-
-	switch(settings.Interface)
-	{
-	case Jtag:
-		if (m_bVerbose)
-			printf("Selecting JTAG interface...\n");
-		if (MSP430_Configure(INTERFACE_MODE, JTAG_IF) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot select JTAG interface", false);
-		break;
-	case SpyBiWare:
-		if (m_bVerbose)
-			printf("Selecting Spy-bi-Wire interface...\n");
-		if (MSP430_Configure(INTERFACE_MODE, SPYBIWIRE_IF) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot select Spy-bi-Wire interface", false);
-		break;
-	case JtagOverSpyBiWare:
-		if (m_bVerbose)
-			printf("Selecting JTAG-over-Spy-bi-Wire interface...\n");
-		if (MSP430_Configure(INTERFACE_MODE, SPYBIWIREJTAG_IF) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot select JTAG-over-Spy-bi-Wire interface", false);
-		break;
-	case AutomaticInterface:
-		if (m_bVerbose)
-			printf("Selecting auto interface...\n");
-		if (MSP430_Configure(INTERFACE_MODE, AUTOMATIC_IF) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot select auto interface", false);
-		break;
-	}
-
-	switch(settings.InterfaceSpeed)
-	{
-	case Slow:
-		if (m_bVerbose)
-			printf("Setting interface speed to slow...\n");
-		if (MSP430_Configure(SET_INTERFACE_SPEED, SLOW) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot set interface speed", false);
-		break;
-	case Medium:
-		if (m_bVerbose)
-			printf("Setting interface speed to medium...\n");
-		if (MSP430_Configure(SET_INTERFACE_SPEED, MEDIUM) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot set interface speed", false);
-		break;
-	case Fast:
-		if (m_bVerbose)
-			printf("Setting interface speed to fast...\n");
-		if (MSP430_Configure(SET_INTERFACE_SPEED, FAST) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot set interface speed", false);
-		break;
-	}
-
-	if (settings.Voltage != 0)
-	{
-		if (MSP430_VCC(settings.Voltage) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot enable Vcc", false);
-	}
-
-	if (MSP430_OpenDevice("DEVICE_UNKNOWN", "", 0, 0, DEVICE_UNKNOWN) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot identify the MSP430 device", false);
-
-	if (MSP430_GetFoundDevice((char *)&m_DeviceInfo, sizeof(m_DeviceInfo)) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot identify the MSP430 device", false);
-
-	if (MSP430_Reset(ALL_RESETS, FALSE, FALSE) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot reset the MSP430 device", false);
-
-	m_bEraseInfoMem = settings.EraseInfoMem;
-	if (settings.AutoErase)
-	{
-		printf("Erasing FLASH...\n");
-		if (MSP430_Erase(m_bEraseInfoMem ? ERASE_ALL : ERASE_MAIN, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart) != STATUS_OK)
-			printf("Warning: cannot erase FLASH: %s\n", GetLastMSP430Error());
-		else
-			m_bFLASHErased = true;
-	}
-
-	m_b32BitRegisterMode = settings.Emulate32BitRegisters;
-
-	m_DeviceInfo.string[__countof(m_DeviceInfo.string) - 1] = 0;
-	printf("Found a device: %s\n", m_DeviceInfo.string);
-	printf("Number of hardware breakpoints: %d\n", m_DeviceInfo.nBreakpoints);
-	printf("%d bytes of FLASH memory (0x%04x-0x%04x)\n", m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd);
-	printf("%d bytes of RAM (0x%04x-0x%04x)\n", m_DeviceInfo.ramEnd - m_DeviceInfo.ramStart + 1, m_DeviceInfo.ramStart, m_DeviceInfo.ramEnd);
-	if (m_DeviceInfo.ram2End || m_DeviceInfo.ram2Start)
-		printf("%d bytes of RAM2 (0x%04x-0x%04x)\n", m_DeviceInfo.ram2End - m_DeviceInfo.ram2Start + 1, m_DeviceInfo.ram2Start, m_DeviceInfo.ram2End);
-	printf("%d bytes of INFO memory (0x%04x-0x%04x)\n", m_DeviceInfo.infoEnd - m_DeviceInfo.infoStart + 1, m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd);
-
-	m_UsedBreakpoints.resize(m_DeviceInfo.nBreakpoints);
-	m_bValid = true;
-	return true;
-}
-
-#include "GlobalSessionMonitor.h"
-
-MSP430Proxy::MSP430GDBTarget::~MSP430GDBTarget()
-{
-	if (m_bClosePending)
-	{
-		printf("GDB Disconnected. Releasing MSP430 interface.\n");
-		MSP430_Close(FALSE);
-	}
-
-	g_SessionMonitor.UnregisterSession(this);
-}
-
-bool MSP430Proxy::MSP430GDBTarget::WaitForJTAGEvent()
-{
-	LONGLONG lastReportTime = {0,};
-	for (;;)
-	{
-		LONG state = 0;
-		if (MSP430_State(&state, m_BreakInPending, NULL) != STATUS_OK)
-			REPORT_AND_RETURN("Cannot query device state", false);
-
-		if (m_bVerbose)
-		{
-			LONGLONG currentTime = {0,};
-			GetSystemTimeAsFileTime(reinterpret_cast<FILETIME *>(&currentTime));
-			if ((currentTime - lastReportTime) > (3000000))	//300ms
-			{
-				printf("MSP430_State() => %d, break-in %s\n", state, m_BreakInPending ? "requested" : "not requested");
-			}
-		}
-
-		if (state != RUNNING)
-		{
-			m_BreakInPending = false;
-			return true;
-		}
-	}
-}
-
-GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::ExecuteRemoteCommand( const std::string &command, std::string &output )
-{
-	if (command == "help")
-	{
-		output = "Supported stub commands:\n\
-\tmon help      - Display this message\n\
-\tmon erase     - Erase the FLASH memory\n\
-\tmon detach    - Disconnect the target, but keep it running\n";
-		return kGDBSuccess;
-	}
-	else if (command == "erase")
-	{
-		if (MSP430_Erase(m_bEraseInfoMem ? ERASE_ALL : ERASE_MAIN, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart) != STATUS_OK)
-		{
-			output = "Cannot erase FLASH: ";
-			output += GetLastMSP430Error();
-			output += "\n";
-		}
-		else
-		{
-			output = "Flash memory erased. Run \"load\" to program your binary.\n";
-			m_bFLASHErased = true;
-		}
-
-		return kGDBSuccess;
-	}
-	else if (command == "detach")
-	{
-		STATUS_T status = MSP430_Run(FREE_RUN, TRUE);
-		if (status == STATUS_OK)
-		{
-			output = "Successfully detached from target\n";
-			m_bDetached = true;
-		}
-		else
-			output = "Failed to resume target\n";
-
-		return kGDBSuccess;
-	}
-	else
-		return kGDBNotSupported;
-}
-
-GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::GetEmbeddedMemoryRegions( std::vector<EmbeddedMemoryRegion> &regions )
-{
-	if (m_DeviceInfo.mainStart || m_DeviceInfo.mainEnd)
-		regions.push_back(EmbeddedMemoryRegion(mtFLASH, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1, MAIN_SEGMENT_SIZE));
-	if (m_DeviceInfo.ramStart || m_DeviceInfo.ramEnd)
-		regions.push_back(EmbeddedMemoryRegion(mtRAM, m_DeviceInfo.ramStart, m_DeviceInfo.ramEnd- m_DeviceInfo.ramStart + 1));
-	if (m_DeviceInfo.ram2Start || m_DeviceInfo.ram2End)
-		regions.push_back(EmbeddedMemoryRegion(mtRAM, m_DeviceInfo.ram2Start, m_DeviceInfo.ram2End- m_DeviceInfo.ram2Start + 1));
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::GetLastStopRecord( TargetStopRecord *pRec )
-{
-	pRec->Reason = kSignalReceived;
-	pRec->Extension.SignalNumber = SIGTRAP;
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::ResumeAndWait( int threadID )
-{
-	if (!DoResumeTarget(RUN_TO_BREAKPOINT))
-		return kGDBUnknownError;
-
-	if (!WaitForJTAGEvent())
-		return kGDBUnknownError;
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::Step( int threadID )
-{
-	if (!DoResumeTarget(SINGLE_STEP))
-		return kGDBUnknownError;
-
-	if (!WaitForJTAGEvent())
-		return kGDBUnknownError;
-
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::SendBreakInRequestAsync()
-{
-	m_BreakInPending = true;
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadFrameRelatedRegisters( int threadID, RegisterSetContainer &registers )
-{
-	LONG rawRegs[16] = {0,};
-	if (MSP430_Read_Registers(rawRegs, MASKREG(PC) | MASKREG(SP)) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot read frame-related registers", kGDBUnknownError);
-
-	registers[PC] = RegisterValue(rawRegs[PC], m_b32BitRegisterMode ? 4 : 2);
-	registers[SP] = RegisterValue(rawRegs[SP], m_b32BitRegisterMode ? 4 : 2);
-
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadTargetRegisters( int threadID, RegisterSetContainer &registers )
-{
-	LONG rawRegs[16] = {0,};
-	if (MSP430_Read_Registers(rawRegs, ALL_REGS) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot read device registers", kGDBUnknownError);
-
-	for (size_t i = 0; i < __countof(rawRegs); i++)
-		registers[i] = RegisterValue(rawRegs[i], m_b32BitRegisterMode ? 4 : 2);
-	
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::WriteTargetRegisters( int threadID, const RegisterSetContainer &registers )
-{
-	LONG rawRegs[16] = {0,};
-	int mask = 0;
-
-	for (size_t i = 0; i < 16; i++)
-		if (registers[i].Valid)
-		{
-			mask |= MASKREG(i);
-			rawRegs[i] = registers[i].ToUInt16();
-		}
-
-	if (MSP430_Write_Registers(rawRegs, mask) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot write device registers", kGDBUnknownError);
-
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadTargetMemory( ULONGLONG Address, void *pBuffer, size_t *pSizeInBytes )
-{
-	size_t readSize = *pSizeInBytes;
-	if (MSP430_Read_Memory((LONG)Address, (char *)pBuffer, *pSizeInBytes) != STATUS_OK)
-	{
-		char szMsg[256];
-		_snprintf(szMsg, _TRUNCATE, "Cannot read %d memory bytes at 0x%I64X", readSize, Address);
-		REPORT_AND_RETURN(szMsg, kGDBUnknownError);
-	}
-
-	if (m_bVerbose)
-		printf("MSP430_Read_Memory(0x%x, %d) => success\n", (LONG)Address, *pSizeInBytes);
-
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::WriteTargetMemory( ULONGLONG Address, const void *pBuffer, size_t sizeInBytes )
-{
-	if (Address >= m_DeviceInfo.mainStart && Address <= m_DeviceInfo.mainEnd)
-	{
-		if (!m_bFLASHErased)
-		{
-			printf("Error: FLASH needs to be erased before programming.\nPlease either use gdb with XML support, or execute \"mon erase\" command in GDB.");
-			return kGDBUnknownError;
-		}
-	}
-
-	if (MSP430_Write_Memory((LONG)Address, (char *)pBuffer, sizeInBytes) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot write device memory", kGDBUnknownError);
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::GetDynamicLibraryList( std::vector<DynamicLibraryRecord> &libraries )
-{
-	return kGDBNotSupported;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::GetThreadList( std::vector<ThreadRecord> &threads )
-{
-	return kGDBNotSupported;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::SetThreadModeForNextCont( int threadID, DebugThreadMode mode, OUT bool *pNeedRestoreCall, IN OUT INT_PTR *pRestoreCookie )
-{
-	return kGDBNotSupported;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::Terminate()
-{
-	return kGDBNotSupported;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::CreateBreakpoint( BreakpointType type, ULONGLONG Address, unsigned kind, OUT INT_PTR *pCookie )
-{
-	printf("Warning! Breakpoints are no longer supported in non-EEM mode.\n");
-	return kGDBUnknownError;
-}
-
-GDBServerFoundation::GDBStatus MSP430GDBTarget::RemoveBreakpoint( BreakpointType type, ULONGLONG Address, INT_PTR Cookie )
-{
-	printf("Warning! Breakpoints are no longer supported in non-EEM mode.\n");
-	return kGDBUnknownError;
-}
-
-GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::EraseFLASH( ULONGLONG addr, size_t length )
-{
-	m_bFLASHCommandsUsed = true;
-	if (MSP430_Erase(ERASE_SEGMENT, (LONG)addr, length) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot erase FLASH memory", kGDBUnknownError);
-	m_bFLASHErased = true;
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::WriteFLASH( ULONGLONG addr, const void *pBuffer, size_t length )
-{
-	m_bFLASHCommandsUsed = true;
-	if (MSP430_Write_Memory((LONG)addr, (char *)pBuffer, length) != STATUS_OK)
-		REPORT_AND_RETURN("Cannot program FLASH memory", kGDBUnknownError);
-	return kGDBSuccess;
-}
-
-GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::CommitFLASHWrite()
-{
-	m_bFLASHCommandsUsed = true;
-	return kGDBSuccess;
-}
-
-void MSP430Proxy::MSP430GDBTarget::ReportLastMSP430Error( const char *pHint )
-{
-	if (pHint)
-		printf("%s: %s\n", pHint, GetLastMSP430Error());
-	else
-		printf("%s\n", GetLastMSP430Error());
-}
-
-bool MSP430Proxy::MSP430GDBTarget::DoResumeTarget( RUN_MODES_t mode )
-{
-	STATUS_T status = MSP430_Run(mode, FALSE);
-	if (m_bVerbose)
-		printf("MSP430_Run(%d) => %d\n", mode, status);
-
-	if (status != STATUS_OK)
-		REPORT_AND_RETURN("Cannot resume device", false);
-
-	return true;
-}
-
+#include "stdafx.h"
+#include "MSP430Target.h"
+#include "MSP430Util.h"
+#include <algorithm>
+
+using namespace GDBServerFoundation;
+using namespace MSP430Proxy;
+
+#define REPORT_AND_RETURN(msg, result) { ReportLastMSP430Error(msg); return result; }
+#define MAIN_SEGMENT_SIZE 512
+#define SEARCH_CHUNK_SIZE 4096
+
+bool MSP430Proxy::MSP430GDBTarget::Initialize(const GlobalSettings &settings)
+{
+	if (m_bClosePending)
+		return m_bValid;
+
+	m_bVerbose = settings.Verbose;
+
+	LONG version = 0;
+	if (MSP430_Initialize((char *)settings.PortName, &version) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot initialize MSP430.DLL", false);
+	m_bClosePending = true;
+
+	switch(settings.Interface)
+	{
+	case Jtag:
+		if (m_bVerbose)
+			printf("Selecting JTAG interface...\n");
+		if (MSP430_Configure(INTERFACE_MODE, JTAG_IF) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot select JTAG interface", false);
+		break;
+	case SpyBiWare:
+		if (m_bVerbose)
+			printf("Selecting Spy-bi-Wire interface...\n");
+		if (MSP430_Configure(INTERFACE_MODE, SPYBIWIRE_IF) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot select Spy-bi-Wire interface", false);
+		break;
+	case JtagOverSpyBiWare:
+		if (m_bVerbose)
+			printf("Selecting JTAG-over-Spy-bi-Wire interface...\n");
+		if (MSP430_Configure(INTERFACE_MODE, SPYBIWIREJTAG_IF) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot select JTAG-over-Spy-bi-Wire interface", false);
+		break;
+	case AutomaticInterface:
+		if (m_bVerbose)
+			printf("Selecting auto interface...\n");
+		if (MSP430_Configure(INTERFACE_MODE, AUTOMATIC_IF) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot select auto interface", false);
+		break;
+	}
+
+	switch(settings.InterfaceSpeed)
+	{
+	case Slow:
+		if (m_bVerbose)
+			printf("Setting interface speed to slow...\n");
+		if (MSP430_Configure(SET_INTERFACE_SPEED, SLOW) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot set interface speed", false);
+		break;
+	case Medium:
+		if (m_bVerbose)
+			printf("Setting interface speed to medium...\n");
+		if (MSP430_Configure(SET_INTERFACE_SPEED, MEDIUM) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot set interface speed", false);
+		break;
+	case Fast:
+		if (m_bVerbose)
+			printf("Setting interface speed to fast...\n");
+		if (MSP430_Configure(SET_INTERFACE_SPEED, FAST) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot set interface speed", false);
+		break;
+	}
+
+	if (settings.Voltage != 0)
+	{
+		if (MSP430_VCC(settings.Voltage) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot enable Vcc", false);
+	}
+
+	if (MSP430_OpenDevice("DEVICE_UNKNOWN", "", 0, 0, DEVICE_UNKNOWN) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot identify the MSP430 device", false);
+
+	if (MSP430_GetFoundDevice((char *)&m_DeviceInfo, sizeof(m_DeviceInfo)) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot identify the MSP430 device", false);
+
+	if (MSP430_Reset(ALL_RESETS, FALSE, FALSE) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot reset the MSP430 device", false);
+
+	//FRAM is byte-writable without erasing and can be modified by the running program, so it is treated like RAM
+	m_bFRAMMainMemory = (m_DeviceInfo.HasFramMemroy != 0);
+	if (m_bFRAMMainMemory && m_bVerbose)
+		printf("FRAM device detected. Main memory will be programmed without erasing.\n");
+
+	//Peripheral registers may have read side effects, so only the memory arrays are registered. Everything else falls into the default side-effecting region.
+	if (m_DeviceInfo.mainStart || m_DeviceInfo.mainEnd)
+	{
+		unsigned policy = rpCacheable | rpPrefetchable | rpWriteThrough;
+		if (settings.FLASHShadow && !m_bFRAMMainMemory)
+			policy |= rpImmutableWhileHalted;
+		m_MemoryCache.AddRegion(m_bFRAMMainMemory ? "fram" : "main", m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, policy, settings.FLASHReadAheadSize);
+	}
+	if (m_DeviceInfo.infoStart || m_DeviceInfo.infoEnd)
+		m_MemoryCache.AddRegion("info", m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd, rpCacheable | rpPrefetchable | rpWriteThrough, settings.FLASHReadAheadSize);
+	if (m_DeviceInfo.bslStart || m_DeviceInfo.bslEnd)
+		m_MemoryCache.AddRegion("bsl", m_DeviceInfo.bslStart, m_DeviceInfo.bslEnd, rpCacheable | rpPrefetchable | rpImmutableWhileHalted | rpWriteThrough, settings.FLASHReadAheadSize);
+	unsigned ramPolicy = rpCacheable | rpPrefetchable | rpWriteThrough;
+	if (settings.RAMWriteCombining)
+		ramPolicy |= rpWriteCombining;
+	if (m_DeviceInfo.ramStart || m_DeviceInfo.ramEnd)
+		m_MemoryCache.AddRegion("ram", m_DeviceInfo.ramStart, m_DeviceInfo.ramEnd, ramPolicy, settings.RAMReadAheadSize);
+	if (m_DeviceInfo.ram2Start || m_DeviceInfo.ram2End)
+		m_MemoryCache.AddRegion("ram2", m_DeviceInfo.ram2Start, m_DeviceInfo.ram2End, ramPolicy, settings.RAMReadAheadSize);
+	if (m_DeviceInfo.lcdStart || m_DeviceInfo.lcdEnd)
+		m_MemoryCache.AddRegion("lcd", m_DeviceInfo.lcdStart, m_DeviceInfo.lcdEnd, rpCacheable | rpWriteThrough);
+	//gdb writes each variable set by a script with a separate packet, so the RAM writes are combined for the entire session.
+	//A failed transfer is reported by the packet that flushes it (an overlapping read, a non-adjacent write, a breakpoint or a resume).
+	if (settings.RAMWriteCombining)
+		m_MemoryCache.BeginCombinedWrites();
+	if (settings.FLASHShadow && !m_bFRAMMainMemory && (m_DeviceInfo.mainStart || m_DeviceInfo.mainEnd))
+	{
+		m_MemoryCache.EnableFLASHShadow(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, MAIN_SEGMENT_SIZE);
+		if (settings.FLASHImageCacheDir)
+		{
+			m_pFLASHImageCache = new FLASHImageCache(settings.FLASHImageCacheDir, settings.PortName, m_DeviceInfo.id, m_DeviceInfo.jtagId, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, MAIN_SEGMENT_SIZE);
+			if (!settings.AutoErase)
+				LoadFLASHImageCache();
+		}
+	}
+
+	if (settings.CountFLASHWear && !m_bFRAMMainMemory && (m_DeviceInfo.mainStart || m_DeviceInfo.mainEnd))
+	{
+		m_pWearCounter = new FLASHWearCounter(NULL, settings.PortName, m_DeviceInfo.id, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, MAIN_SEGMENT_SIZE, GetInfoSegmentSize(m_DeviceInfo), settings.FLASHWearWarningThreshold);
+		m_pWearCounter->Load();
+
+		unsigned maxEraseCount = m_pWearCounter->GetMaximumEraseCount();
+		if (settings.FLASHWearWarningThreshold && maxEraseCount >= settings.FLASHWearWarningThreshold)
+			printf("Warning: some FLASH segments have been erased %d times. Run \"mon wear\" for details.\n", maxEraseCount);
+	}
+
+	m_bEraseInfoMem = settings.EraseInfoMem;
+	m_bStopPrefetch = settings.StopPrefetch;
+	m_bFastLoad = settings.FastLoad;
+	m_bPipelinedFLASHLoad = settings.PipelinedFLASHLoad;
+	if (settings.AutoErase)
+	{
+		printf("Erasing FLASH...\n");
+		if (MSP430_Erase(m_bEraseInfoMem ? ERASE_ALL : ERASE_MAIN, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart) != STATUS_OK)
+			printf("Warning: cannot erase FLASH: %s\n", GetLastMSP430Error());
+		else
+		{
+			m_bFLASHErased = true;
+			m_MemoryCache.OnFLASHErased(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+			RecordMassFLASHErase();
+		}
+	}
+
+	m_b32BitRegisterMode = settings.Emulate32BitRegisters;
+
+	m_DeviceInfo.string[__countof(m_DeviceInfo.string) - 1] = 0;
+	printf("Found a device: %s\n", m_DeviceInfo.string);
+	printf("Number of hardware breakpoints: %d\n", m_DeviceInfo.nBreakpoints);
+	printf("%d bytes of FLASH memory (0x%04x-0x%04x)\n", m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd);
+	printf("%d bytes of RAM (0x%04x-0x%04x)\n", m_DeviceInfo.ramEnd - m_DeviceInfo.ramStart + 1, m_DeviceInfo.ramStart, m_DeviceInfo.ramEnd);
+	if (m_DeviceInfo.ram2End || m_DeviceInfo.ram2Start)
+		printf("%d bytes of RAM2 (0x%04x-0x%04x)\n", m_DeviceInfo.ram2End - m_DeviceInfo.ram2Start + 1, m_DeviceInfo.ram2Start, m_DeviceInfo.ram2End);
+	printf("%d bytes of INFO memory (0x%04x-0x%04x)\n", m_DeviceInfo.infoEnd - m_DeviceInfo.infoStart + 1, m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd);
+
+	std::string regions;
+	m_MemoryCache.GetRegionTable().Format(regions, false);
+	printf("Memory regions:\n%s", regions.c_str());
+
+	m_UsedBreakpoints.resize(m_DeviceInfo.nBreakpoints);
+	m_bValid = true;
+	return true;
+}
+
+#include "GlobalSessionMonitor.h"
+
+MSP430Proxy::MSP430GDBTarget::~MSP430GDBTarget()
+{
+	delete m_pJTAGWorker;
+	if (m_bValid && !m_MemoryCache.FlushWrites())
+		printf("Warning: cannot write device memory: %s\n", GetLastMSP430Error());
+
+	if (m_pFLASHImageCache)
+	{
+		if (m_bValid)
+			SaveFLASHImageCache();
+		delete m_pFLASHImageCache;
+	}
+
+	delete m_pWearCounter;
+
+	if (m_bClosePending)
+	{
+		printf("GDB Disconnected. Releasing MSP430 interface.\n");
+		MSP430_Close(FALSE);
+	}
+
+	if (m_bSessionRegistered)
+		g_SessionMonitor.UnregisterSession(this);
+}
+
+bool MSP430Proxy::MSP430GDBTarget::RegisterSession()
+{
+	m_bSessionRegistered = g_SessionMonitor.RegisterSession(this);
+	return m_bSessionRegistered;
+}
+
+bool MSP430Proxy::MSP430GDBTarget::WaitForJTAGEvent()
+{
+	LONGLONG lastReportTime = {0,};
+	for (;;)
+	{
+		LONG state = 0;
+		if (MSP430_State(&state, m_BreakInPending, NULL) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot query device state", false);
+
+		if (m_bVerbose)
+		{
+			LONGLONG currentTime = {0,};
+			GetSystemTimeAsFileTime(reinterpret_cast<FILETIME *>(&currentTime));
+			if ((currentTime - lastReportTime) > (3000000))	//300ms
+			{
+				printf("MSP430_State() => %d, break-in %s\n", state, m_BreakInPending ? "requested" : "not requested");
+			}
+		}
+
+		if (state != RUNNING)
+		{
+			m_BreakInPending = false;
+			return true;
+		}
+	}
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::ExecuteRemoteCommand( const std::string &command, std::string &output )
+{
+	if (command == "help")
+	{
+		output = "Supported stub commands:\n\
+\tmon help      - Display this message\n\
+\tmon erase     - Erase the FLASH memory\n\
+\tmon detach    - Disconnect the target, but keep it running\n\
+\tmon cache     - Display target memory cache statistics\n\
+\tmon regions   - Display memory regions, their access policies and traffic\n\
+\tmon wear      - Display the amount of erase cycles of each FLASH segment\n";
+		return kGDBSuccess;
+	}
+	else if (command == "erase")
+	{
+		m_MemoryCache.Invalidate(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+		if (m_bEraseInfoMem)
+			m_MemoryCache.Invalidate(m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd - m_DeviceInfo.infoStart + 1);
+
+		if (MSP430_Erase(m_bEraseInfoMem ? ERASE_ALL : ERASE_MAIN, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart) != STATUS_OK)
+		{
+			output = "Cannot erase FLASH: ";
+			output += GetLastMSP430Error();
+			output += "\n";
+		}
+		else
+		{
+			output = "Flash memory erased. Run \"load\" to program your binary.\n";
+			m_bFLASHErased = true;
+			RecordMassFLASHErase();
+			m_MemoryCache.OnFLASHErased(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+		}
+
+		return kGDBSuccess;
+	}
+	else if (command == "detach")
+	{
+		if (!m_MemoryCache.FlushWrites())
+			printf("Warning: cannot write device memory: %s\n", GetLastMSP430Error());
+		m_MemoryCache.AdvanceEpoch();
+		m_bTargetResumed = true;
+		STATUS_T status = MSP430_Run(FREE_RUN, TRUE);
+		if (status == STATUS_OK)
+		{
+			output = "Successfully detached from target\n";
+			m_bDetached = true;
+		}
+		else
+			output = "Failed to resume target\n";
+
+		return kGDBSuccess;
+	}
+	else if (command == "cache")
+	{
+		const TargetMemoryCache::Statistics &stats = m_MemoryCache.GetStatistics();
+		char szMsg[256];
+		_snprintf_s(szMsg, _TRUNCATE, "Memory cache: %d hits, %d misses (%d widened by read-ahead), %d uncached reads\n%I64d bytes requested, %I64d bytes served from cache, %I64d bytes read from device\n%d post-stop prefetches (%I64d bytes)\n%d RAM writes combined into %d transfers\n",
+			stats.Hits, stats.Misses, stats.ReadAheadFetches, stats.UncachedReads, stats.BytesRequested, stats.BytesFromCache, stats.BytesFromDevice, stats.Prefetches, stats.BytesPrefetched,
+			stats.CombinedWrites, stats.WriteFlushes);
+		output = szMsg;
+
+		unsigned totalSegments = 0, validSegments = m_MemoryCache.GetValidShadowSegmentCount(&totalSegments);
+		if (totalSegments)
+		{
+			_snprintf_s(szMsg, _TRUNCATE, "FLASH shadow: %d of %d segments loaded\n", validSegments, totalSegments);
+			output += szMsg;
+		}
+		return kGDBSuccess;
+	}
+	else if (command == "regions")
+	{
+		output.clear();
+		m_MemoryCache.GetRegionTable().Format(output, true);
+		return kGDBSuccess;
+	}
+	else if (command == "wear")
+	{
+		if (m_pWearCounter)
+			m_pWearCounter->Format(output);
+		else
+			output = "FLASH erase cycles are not counted\n";
+		return kGDBSuccess;
+	}
+	else
+		return kGDBNotSupported;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::GetEmbeddedMemoryRegions( std::vector<EmbeddedMemoryRegion> &regions )
+{
+	//Reporting FRAM as RAM makes gdb load it with plain memory writes instead of vFlashErase/vFlashWrite
+	if (m_DeviceInfo.mainStart || m_DeviceInfo.mainEnd)
+	{
+		if (m_bFRAMMainMemory)
+			regions.push_back(EmbeddedMemoryRegion(mtRAM, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1));
+		else
+			regions.push_back(EmbeddedMemoryRegion(mtFLASH, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1, MAIN_SEGMENT_SIZE));
+	}
+	if (m_DeviceInfo.ramStart || m_DeviceInfo.ramEnd)
+		regions.push_back(EmbeddedMemoryRegion(mtRAM, m_DeviceInfo.ramStart, m_DeviceInfo.ramEnd- m_DeviceInfo.ramStart + 1));
+	if (m_DeviceInfo.ram2Start || m_DeviceInfo.ram2End)
+		regions.push_back(EmbeddedMemoryRegion(mtRAM, m_DeviceInfo.ram2Start, m_DeviceInfo.ram2End- m_DeviceInfo.ram2Start + 1));
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::GetLastStopRecord( TargetStopRecord *pRec )
+{
+	pRec->Reason = kSignalReceived;
+	pRec->Extension.SignalNumber = SIGTRAP;
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::ResumeAndWait( int threadID )
+{
+	if (!DoResumeTarget(RUN_TO_BREAKPOINT))
+		return kGDBUnknownError;
+
+	if (!WaitForJTAGEvent())
+		return kGDBUnknownError;
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::Step( int threadID )
+{
+	if (!DoResumeTarget(SINGLE_STEP))
+		return kGDBUnknownError;
+
+	if (!WaitForJTAGEvent())
+		return kGDBUnknownError;
+
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::SendBreakInRequestAsync()
+{
+	m_BreakInPending = true;
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadFrameRelatedRegisters( int threadID, RegisterSetContainer &registers )
+{
+	LONG rawRegs[16] = {0,};
+	if (MSP430_Read_Registers(rawRegs, MASKREG(PC) | MASKREG(SP)) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot read frame-related registers", kGDBUnknownError);
+
+	registers[PC] = RegisterValue(rawRegs[PC], m_b32BitRegisterMode ? 4 : 2);
+	registers[SP] = RegisterValue(rawRegs[SP], m_b32BitRegisterMode ? 4 : 2);
+
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadTargetRegisters( int threadID, RegisterSetContainer &registers )
+{
+	LONG rawRegs[16] = {0,};
+	if (MSP430_Read_Registers(rawRegs, ALL_REGS) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot read device registers", kGDBUnknownError);
+
+	for (size_t i = 0; i < __countof(rawRegs); i++)
+		registers[i] = RegisterValue(rawRegs[i], m_b32BitRegisterMode ? 4 : 2);
+	
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::WriteTargetRegisters( int threadID, const RegisterSetContainer &registers )
+{
+	LONG rawRegs[16] = {0,};
+	int mask = 0;
+
+	for (size_t i = 0; i < 16; i++)
+		if (registers[i].Valid)
+		{
+			mask |= MASKREG(i);
+			rawRegs[i] = registers[i].ToUInt16();
+		}
+
+	if (MSP430_Write_Registers(rawRegs, mask) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot write device registers", kGDBUnknownError);
+
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::ReadTargetMemory( ULONGLONG Address, void *pBuffer, size_t *pSizeInBytes )
+{
+	size_t readSize = *pSizeInBytes;
+	m_PrefetchProfiler.OnMemoryRead((unsigned)Address, readSize);
+	if (!m_MemoryCache.ReadMemory((unsigned)Address, pBuffer, *pSizeInBytes))
+	{
+		char szMsg[256];
+		_snprintf(szMsg, _TRUNCATE, "Cannot read %d memory bytes at 0x%I64X", readSize, Address);
+		REPORT_AND_RETURN(szMsg, kGDBUnknownError);
+	}
+
+	if (m_bVerbose)
+		printf("MSP430_Read_Memory(0x%x, %d) => success\n", (LONG)Address, *pSizeInBytes);
+
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::WriteTargetMemory( ULONGLONG Address, const void *pBuffer, size_t sizeInBytes )
+{
+	if (Address >= m_DeviceInfo.mainStart && Address <= m_DeviceInfo.mainEnd && !m_bFRAMMainMemory)
+	{
+		if (!m_bFLASHErased)
+		{
+			printf("Error: FLASH needs to be erased before programming.\nPlease either use gdb with XML support, or execute \"mon erase\" command in GDB.");
+			return kGDBUnknownError;
+		}
+	}
+
+	if (!m_MemoryCache.WriteMemory((unsigned)Address, pBuffer, sizeInBytes))
+		REPORT_AND_RETURN("Cannot write device memory", kGDBUnknownError);
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::WriteTargetMemoryRuns( const std::vector<FLASHWriteBuffer::Run> &runs )
+{
+	GDBStatus status = kGDBSuccess;
+	m_MemoryCache.BeginCombinedWrites();
+	for (size_t i = 0; status == kGDBSuccess && i < runs.size(); i++)
+		status = WriteTargetMemory(runs[i].Start, &runs[i].Data[0], runs[i].Data.size());
+
+	if (!m_MemoryCache.EndCombinedWrites())
+		REPORT_AND_RETURN("Cannot write device memory", kGDBUnknownError);
+	return status;
+}
+
+//Returns the offset of the first occurrence of the pattern using the Boyer-Moore-Horspool algorithm, or -1 if it is not found
+static size_t FindPattern(const unsigned char *pData, size_t length, const unsigned char *pPattern, size_t patternLength, const size_t *pSkipTable)
+{
+	for (size_t offset = 0; (offset + patternLength) <= length; offset += pSkipTable[pData[offset + patternLength - 1]])
+	{
+		if (!memcmp(pData + offset, pPattern, patternLength))
+			return offset;
+	}
+	return -1;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::SearchTargetMemory( ULONGLONG Address, size_t length, const void *pPattern, size_t patternLength, ULONGLONG *pFoundAddress )
+{
+	*pFoundAddress = -1;
+	if (!patternLength || patternLength > SEARCH_CHUNK_SIZE)
+		return kGDBInvalidArgument;
+	if (patternLength > length)
+		return kGDBSuccess;
+
+	size_t skipTable[256];
+	for (size_t i = 0; i < __countof(skipTable); i++)
+		skipTable[i] = patternLength;
+	for (size_t i = 0; i < (patternLength - 1); i++)
+		skipTable[((const unsigned char *)pPattern)[i]] = patternLength - 1 - i;
+
+	//Consecutive chunks overlap by (patternLength - 1) bytes, so that matches crossing the chunk boundary are found as well
+	std::vector<unsigned char> chunk(SEARCH_CHUNK_SIZE + patternLength - 1);
+	for (size_t done = 0; (done + patternLength) <= length; done += SEARCH_CHUNK_SIZE)
+	{
+		size_t todo = chunk.size();
+		if (todo > (length - done))
+			todo = length - done;
+
+		GDBStatus status = ReadTargetMemory(Address + done, &chunk[0], &todo);
+		if (status != kGDBSuccess)
+			return status;
+
+		size_t offset = FindPattern(&chunk[0], todo, (const unsigned char *)pPattern, patternLength, skipTable);
+		if (offset != -1)
+		{
+			*pFoundAddress = Address + done + offset;
+			break;
+		}
+	}
+
+	if (m_bVerbose)
+		printf("Searched %d bytes at 0x%I64X for a %d-byte pattern\n", length, Address, patternLength);
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::ComputeTargetMemoryCRC( ULONGLONG Address, size_t length, unsigned *pCRC )
+{
+	*pCRC = 0xFFFFFFFF;
+	if (!length)
+		return kGDBSuccess;
+
+	//MSP430_VerifyMem() resets the device, so it is only used before the program has been started and the CPU registers are restored afterwards
+	if (!m_bTargetResumed && m_MemoryCache.IsFLASHShadowLoaded((unsigned)Address, length))
+	{
+		if (!m_MemoryCache.FlushWrites())
+			REPORT_AND_RETURN("Cannot write device memory", kGDBUnknownError);
+
+		LONG rawRegs[16] = {0,};
+		if (MSP430_Read_Registers(rawRegs, ALL_REGS) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot read device registers", kGDBUnknownError);
+
+		bool verified = m_MemoryCache.VerifyFLASHShadow((unsigned)Address, length);
+		if (m_bVerbose)
+			printf("MSP430_VerifyMem(0x%I64X, %d) => %s\n", Address, length, verified ? "match" : "mismatch");
+
+		if (MSP430_Write_Registers(rawRegs, ALL_REGS) != STATUS_OK)
+			REPORT_AND_RETURN("Cannot restore device registers", kGDBUnknownError);
+	}
+
+	//If the shadow has been verified (or discarded), the read below is served from the host memory (or a single bulk read from the device)
+	std::vector<unsigned char> buffer(length);
+	size_t readSize = length;
+	GDBStatus status = ReadTargetMemory(Address, &buffer[0], &readSize);
+	if (status != kGDBSuccess)
+		return status;
+
+	*pCRC = UpdateCRC32(*pCRC, &buffer[0], readSize);
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::GetDynamicLibraryList( std::vector<DynamicLibraryRecord> &libraries )
+{
+	return kGDBNotSupported;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::GetThreadList( std::vector<ThreadRecord> &threads )
+{
+	return kGDBNotSupported;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::SetThreadModeForNextCont( int threadID, DebugThreadMode mode, OUT bool *pNeedRestoreCall, IN OUT INT_PTR *pRestoreCookie )
+{
+	return kGDBNotSupported;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::Terminate()
+{
+	return kGDBNotSupported;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::CreateBreakpoint( BreakpointType type, ULONGLONG Address, unsigned kind, OUT INT_PTR *pCookie )
+{
+	printf("Warning! Breakpoints are no longer supported in non-EEM mode.\n");
+	return kGDBUnknownError;
+}
+
+GDBServerFoundation::GDBStatus MSP430GDBTarget::RemoveBreakpoint( BreakpointType type, ULONGLONG Address, INT_PTR Cookie )
+{
+	printf("Warning! Breakpoints are no longer supported in non-EEM mode.\n");
+	return kGDBUnknownError;
+}
+
+void MSP430Proxy::MSP430GDBTarget::BeginFLASHLoad()
+{
+	m_bFLASHCommandsUsed = true;
+	if (m_bFLASHLoadInProgress)
+		return;
+
+	m_bFLASHLoadInProgress = true;
+	m_FLASHLoadStartTime = GetTickCount();
+	m_FLASHLoadStats = FLASHLoadStatistics();
+
+	if (m_bFastLoad)
+	{
+		m_FastLoadRuns.clear();
+		m_bFastLoadActive = SetFLASHSafetyModes(false);
+		if (!m_bFastLoadActive)
+			SetFLASHSafetyModes(true);
+	}
+}
+
+void MSP430Proxy::MSP430GDBTarget::ResetFLASHLoadState()
+{
+	//Also clears the failure flag of the worker
+	if (m_pJTAGWorker)
+		m_pJTAGWorker->WaitForCompletion();
+
+	m_bFLASHLoadInProgress = m_bFLASHWriteStarted = false;
+	m_bPipelinedLoad = m_bFLASHPipelineFailed = false;
+	m_FLASHWriteBuffer.Clear();
+	m_PendingFLASHErases.clear();
+	m_FLASHEraseRanges.clear();
+	m_SubmittedFLASHSegments.clear();
+	m_FastLoadRuns.clear();
+
+	if (m_pWearCounter)
+		m_pWearCounter->SaveIfModified();
+
+	if (m_bFastLoadActive)
+	{
+		m_bFastLoadActive = false;
+		SetFLASHSafetyModes(true);
+		//The RAM used by the FLASH programming routines of the DLL was not restored
+		m_MemoryCache.AdvanceEpoch();
+	}
+}
+
+void MSP430Proxy::MSP430GDBTarget::DiscardUnfinishedFLASHLoad()
+{
+	if (!m_bFLASHLoadInProgress)
+		return;
+
+	printf("Warning: the previous FLASH load was not completed with vFlashDone. Discarding its state.\n");
+	ResetFLASHLoadState();
+}
+
+bool MSP430Proxy::MSP430GDBTarget::SetFLASHSafetyModes( bool enable )
+{
+	if (MSP430_Configure(RAM_PRESERVE_MODE, enable ? ENABLE : DISABLE) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot configure RAM preservation mode", false);
+	if (MSP430_Configure(VERIFICATION_MODE, enable ? ENABLE : DISABLE) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot configure FLASH verification mode", false);
+	return true;
+}
+
+bool MSP430Proxy::MSP430GDBTarget::VerifyMemoryRuns( const std::vector<FLASHWriteBuffer::Run> &runs )
+{
+	if (!m_MemoryCache.FlushWrites())
+		REPORT_AND_RETURN("Cannot write device memory", false);
+
+	std::vector<FLASHWriteBuffer::Run> ranges;
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		const FLASHWriteBuffer::Run &run = runs[i];
+		if (!ranges.empty() && (ranges.back().Start + ranges.back().Data.size()) == run.Start)
+			ranges.back().Data.insert(ranges.back().Data.end(), run.Data.begin(), run.Data.end());
+		else
+			ranges.push_back(run);
+	}
+
+	//MSP430_VerifyMem() only accepts even addresses and lengths, so the odd ranges are extended with the neighbouring bytes
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		FLASHWriteBuffer::Run &range = ranges[i];
+		unsigned char padding = 0;
+		if (range.Start & 1)
+		{
+			if (!m_MemoryCache.ReadMemory(range.Start - 1, &padding, 1))
+				REPORT_AND_RETURN("Cannot read FLASH memory", false);
+			range.Data.insert(range.Data.begin(), padding);
+			range.Start--;
+		}
+		if (range.Data.size() & 1)
+		{
+			if (!m_MemoryCache.ReadMemory((unsigned)(range.Start + range.Data.size()), &padding, 1))
+				REPORT_AND_RETURN("Cannot read FLASH memory", false);
+			range.Data.push_back(padding);
+		}
+	}
+
+	//MSP430_VerifyMem() resets the device
+	LONG rawRegs[16] = {0,};
+	if (MSP430_Read_Registers(rawRegs, ALL_REGS) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot read device registers", false);
+
+	bool verified = true;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		const FLASHWriteBuffer::Run &range = ranges[i];
+		if (MSP430_VerifyMem(range.Start, (LONG)range.Data.size(), (char *)&range.Data[0]) != STATUS_OK)
+		{
+			printf("ERROR: verification failed in 0x%x-0x%x (%s)! The device contents does not match the loaded image.\n",
+				range.Start, range.Start + range.Data.size() - 1, GetLastMSP430Error());
+			m_MemoryCache.Invalidate(range.Start, range.Data.size());
+			verified = false;
+		}
+	}
+
+	if (MSP430_Write_Registers(rawRegs, ALL_REGS) != STATUS_OK)
+		REPORT_AND_RETURN("Cannot restore device registers", false);
+
+	if (m_bVerbose && verified)
+		printf("Verified %d memory range(s) with MSP430_VerifyMem()\n", ranges.size());
+	return verified;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::EraseFLASH( ULONGLONG addr, size_t length )
+{
+	//gdb sends all vFlashErase packets before the first vFlashWrite, so an erase request after a write starts a new load
+	if (m_bFLASHWriteStarted)
+		DiscardUnfinishedFLASHLoad();
+
+	GDBStatus status = DoEraseFLASH(addr, length);
+	if (status != kGDBSuccess)
+		ResetFLASHLoadState();
+	return status;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::DoEraseFLASH( ULONGLONG addr, size_t length )
+{
+	//The FLASH programming code may use the RAM when RAM_PRESERVE_MODE is disabled, so the buffered RAM writes should reach the device first
+	if (!m_MemoryCache.FlushWrites())
+		REPORT_AND_RETURN("Cannot write device memory", kGDBUnknownError);
+
+	//FRAM cells are overwritten directly, so the following vFlashWrite packets are simply programmed over the old contents
+	if (m_bFRAMMainMemory)
+		return kGDBSuccess;
+
+	BeginFLASHLoad();
+	m_bFLASHErased = true;
+	WaitForFLASHPipeline();
+
+	//Main FLASH segments are only erased on commit if the new data differs from the current contents
+	if (addr >= m_DeviceInfo.mainStart && (addr + length - 1) <= m_DeviceInfo.mainEnd)
+	{
+		m_PendingFLASHErases.push_back(std::pair<unsigned, size_t>((unsigned)addr, length));
+		return kGDBSuccess;
+	}
+
+	DWORD eraseStartTime = GetTickCount();
+	if (MSP430_Erase(ERASE_SEGMENT, (LONG)addr, length) != STATUS_OK)
+	{
+		m_MemoryCache.Invalidate((unsigned)addr, length);
+		REPORT_AND_RETURN("Cannot erase FLASH memory", kGDBUnknownError);
+	}
+	m_MemoryCache.OnFLASHErased((unsigned)addr, length);
+	if (m_pWearCounter)
+		m_pWearCounter->OnSegmentsErased((unsigned)addr, length);
+	m_FLASHLoadStats.EraseTime += GetTickCount() - eraseStartTime;
+	return kGDBSuccess;
+}
+
+//Returns true if the FLASH memory containing 'current' can be programmed with 'expected' without erasing (i.e. only by clearing bits)
+static bool CanProgramWithoutErase(const unsigned char *pCurrent, const unsigned char *pExpected, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+		if ((pCurrent[i] & pExpected[i]) != pExpected[i])
+			return false;
+	return true;
+}
+
+//Returns the part of the physical segment at segmentBase (aligned to MAIN_SEGMENT_SIZE like the FLASHWriteBuffer segments) that lies within [start, end)
+static void ClipFLASHSegment(unsigned segmentBase, unsigned start, unsigned end, unsigned *pStart, unsigned *pEnd)
+{
+	*pStart = (segmentBase > start) ? segmentBase : start;
+	*pEnd = ((segmentBase + MAIN_SEGMENT_SIZE) < end) ? (segmentBase + MAIN_SEGMENT_SIZE) : end;
+}
+
+void MSP430Proxy::MSP430GDBTarget::MergePendingFLASHErases( std::vector<std::pair<unsigned, unsigned> > &ranges )
+{
+	//gdb sends one vFlashErase per memory map block
+	std::sort(m_PendingFLASHErases.begin(), m_PendingFLASHErases.end());
+	ranges.clear();
+	for (size_t i = 0; i < m_PendingFLASHErases.size(); i++)
+	{
+		unsigned start = m_PendingFLASHErases[i].first & ~(MAIN_SEGMENT_SIZE - 1);
+		unsigned end = (unsigned)(m_PendingFLASHErases[i].first + m_PendingFLASHErases[i].second + MAIN_SEGMENT_SIZE - 1) & ~(MAIN_SEGMENT_SIZE - 1);
+		if (start < m_DeviceInfo.mainStart)
+			start = m_DeviceInfo.mainStart;
+		if (end > (m_DeviceInfo.mainEnd + 1))
+			end = m_DeviceInfo.mainEnd + 1;
+
+		if (!ranges.empty() && start <= ranges.back().second)
+		{
+			if (end > ranges.back().second)
+				ranges.back().second = end;
+		}
+		else
+			ranges.push_back(std::pair<unsigned, unsigned>(start, end));
+	}
+}
+
+bool MSP430Proxy::MSP430GDBTarget::ErasePendingFLASHSegments( FLASHLoadStatistics *pStats )
+{
+	enum SegmentAction {KeepSegment, ProgramWithoutErase, EraseSegment};
+
+	std::vector<std::pair<unsigned, unsigned> > ranges;
+	MergePendingFLASHErases(ranges);
+	m_PendingFLASHErases.clear();
+
+	//Compare the current contents of each segment (read with a single bulk read per range or taken from the FLASH shadow) with the new data
+	std::vector<std::pair<unsigned, SegmentAction> > segments;
+	unsigned nonBlankUnchangedSegments = 0;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		unsigned start = ranges[i].first, end = ranges[i].second;
+		std::vector<unsigned char> current(end - start);
+		if (!m_MemoryCache.ReadMemory(start, &current[0], current.size()))
+			REPORT_AND_RETURN("Cannot read FLASH memory", false);
+
+		//The segments are aligned to the absolute segment boundaries, so the first one can be partial if the main FLASH does not start on a boundary
+		for (unsigned seg = start & ~(MAIN_SEGMENT_SIZE - 1); seg < end; seg += MAIN_SEGMENT_SIZE)
+		{
+			unsigned segStart, segEnd;
+			ClipFLASHSegment(seg, start, end, &segStart, &segEnd);
+			size_t segLength = segEnd - segStart;
+
+			unsigned char segmentData[MAIN_SEGMENT_SIZE];
+			memset(segmentData, 0xFF, sizeof(segmentData));
+			m_FLASHWriteBuffer.ApplyToSegment(seg, segmentData, sizeof(segmentData));
+			const unsigned char *pExpected = segmentData + (segStart - seg), *pCurrent = &current[segStart - start];
+
+			SegmentAction action;
+			if (!memcmp(pCurrent, pExpected, segLength))
+			{
+				action = KeepSegment;
+				for (size_t j = 0; j < segLength; j++)
+					if (pExpected[j] != 0xFF)
+					{
+						nonBlankUnchangedSegments++;
+						break;
+					}
+			}
+			else if (CanProgramWithoutErase(pCurrent, pExpected, segLength))
+				action = ProgramWithoutErase;
+			else
+				action = EraseSegment;
+
+			segments.push_back(std::pair<unsigned, SegmentAction>(seg, action));
+		}
+	}
+
+	unsigned segmentsToErase = 0;
+	for (size_t i = 0; i < segments.size(); i++)
+		if (segments[i].second == EraseSegment)
+			segmentsToErase++;
+
+	//If the entire main FLASH was requested to be erased, a single mass erase is used unless it would require rewriting more unchanged segments than it saves erases
+	if (ranges.size() == 1 && ranges[0].first == m_DeviceInfo.mainStart && ranges[0].second == (m_DeviceInfo.mainEnd + 1) && segmentsToErase > nonBlankUnchangedSegments)
+	{
+		if (m_bVerbose)
+			printf("Erasing the entire main FLASH (%d segments need erasing)\n", segmentsToErase);
+
+		if (MSP430_Erase(m_bEraseInfoMem ? ERASE_ALL : ERASE_MAIN, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart) != STATUS_OK)
+		{
+			m_MemoryCache.Invalidate(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+			REPORT_AND_RETURN("Cannot erase FLASH memory", false);
+		}
+
+		m_MemoryCache.OnFLASHErased(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+		if (m_bEraseInfoMem)
+			m_MemoryCache.Invalidate(m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd - m_DeviceInfo.infoStart + 1);
+		RecordMassFLASHErase();
+
+		pStats->ErasedSegments = (unsigned)segments.size();
+		pStats->MassErase = true;
+		return true;
+	}
+
+	//Otherwise consecutive segments that need erasing are erased with a single call
+	for (size_t i = 0; i < segments.size(); )
+	{
+		if (segments[i].second == KeepSegment)
+		{
+			//Only the main FLASH part is dropped. The rest of a partial segment may hold buffered information memory data.
+			unsigned keepStart, keepEnd;
+			ClipFLASHSegment(segments[i].first, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd + 1, &keepStart, &keepEnd);
+			m_FLASHWriteBuffer.Discard(keepStart, keepEnd - keepStart);
+			pStats->UnchangedSegments++;
+			i++;
+			continue;
+		}
+		else if (segments[i].second == ProgramWithoutErase)
+		{
+			pStats->SegmentsWithoutErase++;
+			i++;
+			continue;
+		}
+
+		size_t runEnd = i + 1;
+		while (runEnd < segments.size() && segments[runEnd].second == EraseSegment && segments[runEnd].first == (segments[runEnd - 1].first + MAIN_SEGMENT_SIZE))
+			runEnd++;
+
+		unsigned eraseStart, eraseEnd, unused;
+		ClipFLASHSegment(segments[i].first, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd + 1, &eraseStart, &unused);
+		ClipFLASHSegment(segments[runEnd - 1].first, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd + 1, &unused, &eraseEnd);
+
+		if (MSP430_Erase(ERASE_SEGMENT, eraseStart, eraseEnd - eraseStart) != STATUS_OK)
+		{
+			m_MemoryCache.Invalidate(eraseStart, eraseEnd - eraseStart);
+			REPORT_AND_RETURN("Cannot erase FLASH memory", false);
+		}
+		m_MemoryCache.OnFLASHErased(eraseStart, eraseEnd - eraseStart);
+		if (m_pWearCounter)
+			m_pWearCounter->OnSegmentsErased(eraseStart, eraseEnd - eraseStart);
+
+		pStats->ErasedSegments += (unsigned)(runEnd - i);
+		i = runEnd;
+	}
+
+	return true;
+}
+
+class MSP430Proxy::MSP430GDBTarget::ProgramSegmentJob : public JTAGWorkerThread::IJob
+{
+private:
+	MSP430GDBTarget *m_pTarget;
+	unsigned m_SegmentBase;
+	FLASHWriteBuffer::Segment m_Segment;
+
+public:
+	ProgramSegmentJob(MSP430GDBTarget *pTarget, unsigned segmentBase, const FLASHWriteBuffer::Segment &segment)
+		: m_pTarget(pTarget)
+		, m_SegmentBase(segmentBase)
+		, m_Segment(segment)
+	{
+	}
+
+	virtual bool Run()
+	{
+		return m_pTarget->ProgramFLASHSegment(m_SegmentBase, m_Segment);
+	}
+};
+
+class MSP430Proxy::MSP430GDBTarget::PrefetchJob : public JTAGWorkerThread::IJob
+{
+private:
+	MSP430GDBTarget *m_pTarget;
+	unsigned m_Address;
+	size_t m_Length;
+
+public:
+	PrefetchJob(MSP430GDBTarget *pTarget, unsigned addr, size_t length)
+		: m_pTarget(pTarget)
+		, m_Address(addr)
+		, m_Length(length)
+	{
+	}
+
+	virtual bool Run()
+	{
+		//If the prefetch fails, the segments will be read one-by-one when they are programmed
+		m_pTarget->m_MemoryCache.Prefetch(m_Address, m_Length);
+		return true;
+	}
+};
+
+void MSP430Proxy::MSP430GDBTarget::StartPipelinedFLASHLoad()
+{
+	if (!m_bPipelinedFLASHLoad)
+		return;
+
+	std::vector<std::pair<unsigned, unsigned> > ranges;
+	MergePendingFLASHErases(ranges);
+
+	//Choosing between a mass erase and per-segment erases requires the complete image, so such loads are programmed on commit
+	if (ranges.size() == 1 && ranges[0].first == m_DeviceInfo.mainStart && ranges[0].second == (m_DeviceInfo.mainEnd + 1))
+		return;
+
+	m_PendingFLASHErases.clear();
+	m_FLASHEraseRanges = ranges;
+	m_SubmittedFLASHSegments.clear();
+	m_bFLASHPipelineFailed = false;
+
+	if (!m_pJTAGWorker)
+		m_pJTAGWorker = new JTAGWorkerThread();
+
+	//The current contents of the segments to be erased is read while gdb is sending the data
+	for (size_t i = 0; i < ranges.size(); i++)
+		m_pJTAGWorker->Submit(new PrefetchJob(this, ranges[i].first, ranges[i].second - ranges[i].first));
+
+	m_bPipelinedLoad = true;
+}
+
+void MSP430Proxy::MSP430GDBTarget::SubmitFLASHSegment( unsigned segmentBase, const FLASHWriteBuffer::Segment &segment )
+{
+	//If gdb writes a segment that has already been programmed (never happens with ascending writes), the new data is merged
+	//with the previously programmed one, so that erasing the segment does not destroy it
+	FLASHWriteBuffer::SegmentMap::iterator it = m_SubmittedFLASHSegments.find(segmentBase);
+	if (it == m_SubmittedFLASHSegments.end())
+		it = m_SubmittedFLASHSegments.insert(std::pair<unsigned, FLASHWriteBuffer::Segment>(segmentBase, segment)).first;
+	else
+	{
+		for (size_t i = 0; i < FLASHWriteBuffer::SEGMENT_SIZE; i++)
+			if (segment.Written[i])
+				it->second.Data[i] = segment.Data[i];
+		it->second.Written |= segment.Written;
+	}
+
+	m_pJTAGWorker->Submit(new ProgramSegmentJob(this, segmentBase, it->second));
+}
+
+void MSP430Proxy::MSP430GDBTarget::WaitForFLASHPipeline()
+{
+	if (m_pJTAGWorker && !m_pJTAGWorker->IsIdle())
+	{
+		if (!m_pJTAGWorker->WaitForCompletion())
+			m_bFLASHPipelineFailed = true;
+	}
+}
+
+bool MSP430Proxy::MSP430GDBTarget::ProgramFLASHSegment( unsigned segmentBase, const FLASHWriteBuffer::Segment &segment )
+{
+	//The erase ranges are clipped to the main FLASH, so a segment straddling its start only overlaps them partially
+	FLASHWriteBuffer::Segment dataToProgram = segment;
+	bool eraseRequested = false;
+	for (size_t i = 0; i < m_FLASHEraseRanges.size(); i++)
+		if (m_FLASHEraseRanges[i].first < (segmentBase + MAIN_SEGMENT_SIZE) && m_FLASHEraseRanges[i].second > segmentBase)
+			eraseRequested = true;
+
+	if (eraseRequested)
+	{
+		unsigned segStart, segEnd;
+		ClipFLASHSegment(segmentBase, m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd + 1, &segStart, &segEnd);
+		size_t segLength = segEnd - segStart;
+
+		unsigned char current[MAIN_SEGMENT_SIZE], expected[MAIN_SEGMENT_SIZE];
+		for (size_t i = 0; i < segLength; i++)
+			expected[i] = segment.Written[segStart - segmentBase + i] ? segment.Data[segStart - segmentBase + i] : 0xFF;
+
+		if (!m_MemoryCache.ReadMemory(segStart, current, segLength))
+			REPORT_AND_RETURN("Cannot read FLASH memory", false);
+
+		if (!memcmp(current, expected, segLength))
+		{
+			//The rest of a partial segment may still contain information memory data that needs programming
+			for (unsigned addr = segStart; addr < segEnd; addr++)
+				dataToProgram.Written.reset(addr - segmentBase);
+			m_FLASHLoadStats.UnchangedSegments++;
+		}
+		else if (CanProgramWithoutErase(current, expected, segLength))
+			m_FLASHLoadStats.SegmentsWithoutErase++;
+		else
+		{
+			DWORD eraseStartTime = GetTickCount();
+			if (MSP430_Erase(ERASE_SEGMENT, segStart, segLength) != STATUS_OK)
+			{
+				m_MemoryCache.Invalidate(segStart, segLength);
+				REPORT_AND_RETURN("Cannot erase FLASH memory", false);
+			}
+			m_MemoryCache.OnFLASHErased(segStart, segLength);
+			if (m_pWearCounter)
+				m_pWearCounter->OnSegmentsErased(segStart, segLength);
+			m_FLASHLoadStats.ErasedSegments++;
+			m_FLASHLoadStats.EraseTime += GetTickCount() - eraseStartTime;
+		}
+	}
+
+	std::vector<FLASHWriteBuffer::Run> runs;
+	FLASHWriteBuffer::AppendSegmentRuns(segmentBase, dataToProgram, runs);
+	return ProgramFLASHRuns(runs);
+}
+
+bool MSP430Proxy::MSP430GDBTarget::ProgramFLASHRuns( const std::vector<FLASHWriteBuffer::Run> &runs )
+{
+	DWORD startTime = GetTickCount();
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		if (m_bVerbose)
+			printf("Programming %d bytes at 0x%x\n", runs[i].Data.size(), runs[i].Start);
+
+		if (!m_MemoryCache.WriteMemory(runs[i].Start, &runs[i].Data[0], runs[i].Data.size()))
+			REPORT_AND_RETURN("Cannot program FLASH memory", false);
+
+		m_FLASHLoadStats.ProgrammedBytes += runs[i].Data.size();
+		m_FLASHLoadStats.ProgrammedBlocks++;
+		if (m_bFastLoadActive)
+			m_FastLoadRuns.push_back(runs[i]);
+	}
+	m_FLASHLoadStats.ProgramTime += GetTickCount() - startTime;
+	return true;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::WriteFLASH( ULONGLONG addr, const void *pBuffer, size_t length )
+{
+	GDBStatus status = DoWriteFLASH(addr, pBuffer, length);
+	if (status != kGDBSuccess)
+		ResetFLASHLoadState();
+	return status;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::DoWriteFLASH( ULONGLONG addr, const void *pBuffer, size_t length )
+{
+	BeginFLASHLoad();
+	if (!m_bFLASHWriteStarted)
+	{
+		m_bFLASHWriteStarted = true;
+		StartPipelinedFLASHLoad();
+	}
+
+	//Without the pipeline, the data is programmed in large blocks when gdb sends vFlashDone
+	m_FLASHWriteBuffer.Write((unsigned)addr, pBuffer, length);
+	if (!m_bPipelinedLoad)
+		return kGDBSuccess;
+
+	if (m_pJTAGWorker->HasFailed())
+	{
+		printf("Cannot program FLASH memory\n");
+		return kGDBUnknownError;
+	}
+
+	FLASHWriteBuffer::SegmentMap completedSegments;
+	m_FLASHWriteBuffer.TakeSegmentsBelow((unsigned)addr, completedSegments);
+	for (FLASHWriteBuffer::SegmentMap::iterator it = completedSegments.begin(); it != completedSegments.end(); it++)
+		SubmitFLASHSegment(it->first, it->second);
+
+	return kGDBSuccess;
+}
+
+GDBServerFoundation::GDBStatus MSP430Proxy::MSP430GDBTarget::CommitFLASHWrite()
+{
+	BeginFLASHLoad();
+	m_bFLASHLoadInProgress = false;
+	m_bFLASHWriteStarted = false;
+
+	bool succeeded;
+	size_t packetBytes = m_FLASHWriteBuffer.GetBufferedByteCount();
+	if (m_bPipelinedLoad)
+	{
+		FLASHWriteBuffer::SegmentMap remainingSegments;
+		m_FLASHWriteBuffer.TakeSegmentsBelow(-1, remainingSegments);
+		for (FLASHWriteBuffer::SegmentMap::iterator it = remainingSegments.begin(); it != remainingSegments.end(); it++)
+			SubmitFLASHSegment(it->first, it->second);
+
+		//The requested segments that were not written by gdb should still be erased (unless already blank)
+		for (size_t i = 0; i < m_FLASHEraseRanges.size(); i++)
+			for (unsigned seg = m_FLASHEraseRanges[i].first & ~(MAIN_SEGMENT_SIZE - 1); seg < m_FLASHEraseRanges[i].second; seg += MAIN_SEGMENT_SIZE)
+				if (m_SubmittedFLASHSegments.find(seg) == m_SubmittedFLASHSegments.end())
+					SubmitFLASHSegment(seg, FLASHWriteBuffer::Segment());
+
+		succeeded = m_pJTAGWorker->WaitForCompletion() && !m_bFLASHPipelineFailed;
+		m_bPipelinedLoad = m_bFLASHPipelineFailed = false;
+		m_FLASHEraseRanges.clear();
+		m_SubmittedFLASHSegments.clear();
+	}
+	else
+	{
+		std::vector<FLASHWriteBuffer::Run> runs;
+		DWORD eraseStartTime = GetTickCount();
+		succeeded = ErasePendingFLASHSegments(&m_FLASHLoadStats);
+		m_FLASHLoadStats.EraseTime += GetTickCount() - eraseStartTime;
+		if (succeeded)
+		{
+			m_FLASHWriteBuffer.GetMergedRuns(runs);
+			succeeded = ProgramFLASHRuns(runs);
+		}
+	}
+
+	m_FLASHWriteBuffer.Clear();
+	if (m_pWearCounter)
+		m_pWearCounter->SaveIfModified();
+
+	if (m_bFastLoadActive)
+	{
+		m_bFastLoadActive = false;
+		if (succeeded)
+		{
+			DWORD verifyStartTime = GetTickCount();
+			succeeded = m_FLASHLoadStats.Verified = VerifyMemoryRuns(m_FastLoadRuns);
+			m_FLASHLoadStats.VerificationFailed = !succeeded;
+			m_FLASHLoadStats.VerifyTime = GetTickCount() - verifyStartTime;
+		}
+		m_FastLoadRuns.clear();
+		SetFLASHSafetyModes(true);
+
+		//The RAM used by the FLASH programming routines of the DLL was not restored
+		m_MemoryCache.AdvanceEpoch();
+
+		const FLASHLoadStatistics &stats = m_FLASHLoadStats;
+		printf("Fast load: erase %d.%03d sec, program %d.%03d sec, verify %d.%03d sec\n", stats.EraseTime / 1000, stats.EraseTime % 1000,
+			stats.ProgramTime / 1000, stats.ProgramTime % 1000, stats.VerifyTime / 1000, stats.VerifyTime % 1000);
+	}
+
+	if (!succeeded)
+		return kGDBUnknownError;
+
+	const FLASHLoadStatistics &stats = m_FLASHLoadStats;
+	if (stats.MassErase)
+		printf("Erased the entire main FLASH with a single operation\n");
+	else if (stats.UnchangedSegments || stats.SegmentsWithoutErase)
+		printf("Skipped %d unchanged FLASH segment(s), programmed %d segment(s) without erasing, erased %d segment(s)\n", stats.UnchangedSegments, stats.SegmentsWithoutErase, stats.ErasedSegments);
+
+	if (stats.ProgrammedBytes)
+	{
+		DWORD elapsed = GetTickCount() - m_FLASHLoadStartTime;
+		printf("Programmed %d bytes (%d bytes received) in %d block(s) in %d.%03d sec (%d bytes/sec)\n", stats.ProgrammedBytes, packetBytes, stats.ProgrammedBlocks,
+			elapsed / 1000, elapsed % 1000, elapsed ? (unsigned)((ULONGLONG)stats.ProgrammedBytes * 1000 / elapsed) : stats.ProgrammedBytes);
+	}
+
+	SaveFLASHImageCache();
+	return kGDBSuccess;
+}
+
+void MSP430Proxy::MSP430GDBTarget::RecordMassFLASHErase()
+{
+	if (!m_pWearCounter)
+		return;
+
+	m_pWearCounter->OnSegmentsErased(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd - m_DeviceInfo.mainStart + 1);
+	if (m_bEraseInfoMem && (m_DeviceInfo.infoStart || m_DeviceInfo.infoEnd))
+		m_pWearCounter->OnSegmentsErased(m_DeviceInfo.infoStart, m_DeviceInfo.infoEnd - m_DeviceInfo.infoStart + 1);
+	m_pWearCounter->SaveIfModified();
+}
+
+void MSP430Proxy::MSP430GDBTarget::LoadFLASHImageCache()
+{
+	std::vector<unsigned char> image;
+	std::vector<bool> validSegments;
+	if (!m_pFLASHImageCache->Load(image, validSegments))
+	{
+		if (m_bVerbose)
+			printf("No saved FLASH image found in %s\n", m_pFLASHImageCache->GetFileName());
+		return;
+	}
+
+	//Each run of consecutive saved segments is checked with a single device-side checksum (the device is reset by MSP430_VerifyMem())
+	unsigned restoredSegments = 0;
+	for (size_t seg = 0; seg < validSegments.size(); seg++)
+	{
+		if (!validSegments[seg])
+			continue;
+
+		size_t runEnd = seg;
+		while ((runEnd + 1) < validSegments.size() && validSegments[runEnd + 1])
+			runEnd++;
+
+		size_t offset, end, unused;
+		GetFLASHSegmentBounds(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, MAIN_SEGMENT_SIZE, (unsigned)seg, &offset, &unused);
+		GetFLASHSegmentBounds(m_DeviceInfo.mainStart, m_DeviceInfo.mainEnd, MAIN_SEGMENT_SIZE, (unsigned)runEnd, &unused, &end);
+		size_t length = end - offset;
+
+		if (MSP430_VerifyMem(m_DeviceInfo.mainStart + offset, length, (char *)&image[offset]) == STATUS_OK)
+			restoredSegments += runEnd - seg + 1;
+		else
+		{
+			if (m_bVerbose)
+				printf("Saved FLASH image does not match the device at 0x%x-0x%x\n", m_DeviceInfo.mainStart + offset, m_DeviceInfo.mainStart + offset + length - 1);
+			for (size_t i = seg; i <= runEnd; i++)
+				validSegments[i] = false;
+		}
+
+		seg = runEnd;
+	}
+
+	m_MemoryCache.ImportFLASHShadow(image, validSegments);
+	if (restoredSegments)
+		printf("Restored %d of %d FLASH segments from %s\n", restoredSegments, validSegments.size(), m_pFLASHImageCache->GetFileName());
+}
+
+void MSP430Proxy::MSP430GDBTarget::SaveFLASHImageCache()
+{
+	if (!m_pFLASHImageCache)
+		return;
+
+	std::vector<unsigned char> image;
+	std::vector<bool> validSegments;
+	if (!m_MemoryCache.ExportFLASHShadow(image, validSegments))
+		return;
+
+	if (!m_pFLASHImageCache->Save(image, validSegments))
+		printf("Warning: cannot save FLASH image to %s\n", m_pFLASHImageCache->GetFileName());
+}
+
+void MSP430Proxy::MSP430GDBTarget::ReportLastMSP430Error( const char *pHint )
+{
+	if (pHint)
+		printf("%s: %s\n", pHint, GetLastMSP430Error());
+	else
+		printf("%s\n", GetLastMSP430Error());
+}
+
+bool MSP430Proxy::MSP430GDBTarget::DoResumeTarget( RUN_MODES_t mode )
+{
+	if (!m_MemoryCache.FlushWrites())
+		REPORT_AND_RETURN("Cannot write device memory", false);
+	m_MemoryCache.AdvanceEpoch();
+	m_PrefetchProfiler.OnTargetResumed();
+	m_bTargetResumed = true;
+	STATUS_T status = MSP430_Run(mode, FALSE);
+	if (m_bVerbose)
+		printf("MSP430_Run(%d) => %d\n", mode, status);
+
+	if (status != STATUS_OK)
+		REPORT_AND_RETURN("Cannot resume device", false);
+
+	return true;
+}
+
+void MSP430Proxy::MSP430GDBTarget::OnTargetStopped( unsigned pc )
+{
+	if (!m_bStopPrefetch)
+		return;
+
+	std::vector<StopPrefetchProfiler::Range> ranges;
+	m_PrefetchProfiler.OnTargetStopped(pc, &ranges);
+
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (!m_MemoryCache.Prefetch(ranges[i].Start, ranges[i].Length))
+		{
+			if (m_bVerbose)
+				printf("Cannot prefetch %d bytes at 0x%x: %s\n", ranges[i].Length, ranges[i].Start, GetLastMSP430Error());
+		}
+	}
+
+	if (m_bVerbose && !ranges.empty())
+		printf("Prefetched %d memory ranges for PC = 0x%x\n", ranges.size(), pc);
+}
+
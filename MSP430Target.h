@@ -1,104 +1,275 @@
-#pragma once
-#include "GDBServerFoundation/GDBServer.h"
-#include "GDBServerFoundation/GDBStub.h"
-#include "GDBServerFoundation/IGDBTarget.h"
-#include "TI/Inc/MSP430_Debug.h"
-
-#include "registers-msp430.h"
-#include <vector>
-#include "settings.h"
-
-enum MSP430_MSG;
-
-namespace MSP430Proxy
-{
-	using namespace GDBServerFoundation;
-
-	//! Implements debugging functionality without the EEM API (not supporting data breakpoints and software breakpoints).
-	/*!
-		\remarks After creating an instance of this class please call the Initialize() method.
-	*/
-	class MSP430GDBTarget : public ISyncGDBTarget, public IFLASHProgrammer
-	{
-	protected:
-		DEVICE_T m_DeviceInfo;
-		bool m_bVerbose;
-
-	private:
-		bool m_bClosePending, m_bValid;
-		std::vector<bool> m_UsedBreakpoints;
-		
-		bool m_bFLASHErased, m_bDetached;
-		bool m_b32BitRegisterMode;
-		bool m_bEraseInfoMem;
-
-	protected:
-		bool m_BreakInPending, m_bFLASHCommandsUsed;
-
-	protected:
-		virtual bool WaitForJTAGEvent();
-		void ReportLastMSP430Error(const char *pHint);
-		virtual bool DoResumeTarget(RUN_MODES_t mode);
-
-	protected:
-		MSP430GDBTarget()
-			: m_bClosePending(false)
-			, m_bValid(false)
-			, m_bVerbose(false)
-			, m_BreakInPending(false)
-			, m_bFLASHErased(false)
-			, m_bDetached(false)
-			, m_bFLASHCommandsUsed(false)
-			, m_b32BitRegisterMode(false)
-			, m_bEraseInfoMem(false)
-		{
-		}
-	public:
-		~MSP430GDBTarget();
-
-		//! Starts debugging session
-		virtual bool Initialize(const GlobalSettings &settings);
-
-		virtual GDBStatus GetLastStopRecord(TargetStopRecord *pRec);
-		virtual GDBStatus ResumeAndWait(int threadID);
-		virtual GDBStatus Step(int threadID);
-		virtual GDBStatus SendBreakInRequestAsync();
-
-		virtual const PlatformRegisterList *GetRegisterList()
-		{
-			if (m_b32BitRegisterMode)
-				return &GDBServerFoundation::MSP430_32bitRegs::RegisterList;
-			else
-				return &GDBServerFoundation::MSP430::RegisterList;
-		}
-
-	public:	//Register accessing API
-		virtual GDBStatus ReadFrameRelatedRegisters(int threadID, RegisterSetContainer &registers);
-		virtual GDBStatus ReadTargetRegisters(int threadID, RegisterSetContainer &registers);
-		virtual GDBStatus WriteTargetRegisters(int threadID, const RegisterSetContainer &registers);
-
-	public: //Memory accessing API
-		virtual GDBStatus ReadTargetMemory(ULONGLONG Address, void *pBuffer, size_t *pSizeInBytes);
-		virtual GDBStatus WriteTargetMemory(ULONGLONG Address, const void *pBuffer, size_t sizeInBytes);
-
-	public:	//Optional methods, can be left unimplemented
-		virtual GDBStatus GetDynamicLibraryList(std::vector<DynamicLibraryRecord> &libraries);
-		virtual GDBStatus GetThreadList(std::vector<ThreadRecord> &threads);
-		virtual GDBStatus SetThreadModeForNextCont(int threadID, DebugThreadMode mode, OUT bool *pNeedRestoreCall, IN OUT INT_PTR *pRestoreCookie);
-		virtual GDBStatus Terminate();
-
-		virtual GDBStatus CreateBreakpoint(BreakpointType type, ULONGLONG Address, unsigned kind, OUT INT_PTR *pCookie);
-		virtual GDBStatus RemoveBreakpoint(BreakpointType type, ULONGLONG Address, INT_PTR Cookie);
-
-		virtual GDBStatus ExecuteRemoteCommand(const std::string &command, std::string &output);
-
-		virtual IFLASHProgrammer *GetFLASHProgrammer() {return this;}
-
-	public:
-		virtual GDBStatus GetEmbeddedMemoryRegions(std::vector<EmbeddedMemoryRegion> &regions);
-		virtual GDBStatus EraseFLASH(ULONGLONG addr, size_t length);
-		virtual GDBStatus WriteFLASH(ULONGLONG addr, const void *pBuffer, size_t length);
-		virtual GDBStatus CommitFLASHWrite();
-		virtual void CloseSessionSafely() {}
-	};
-}
+#pragma once
+#include "GDBServerFoundation/GDBServer.h"
+#include "GDBServerFoundation/GDBStub.h"
+#include "GDBServerFoundation/IGDBTarget.h"
+#include "TI/Inc/MSP430_Debug.h"
+
+#include "registers-msp430.h"
+#include <vector>
+#include "settings.h"
+#include "TargetMemoryCache.h"
+#include "StopPrefetchProfiler.h"
+#include "FLASHWriteBuffer.h"
+#include "FLASHImageCache.h"
+#include "FLASHWearCounter.h"
+#include "JTAGWorkerThread.h"
+
+enum MSP430_MSG;
+
+namespace MSP430Proxy
+{
+	using namespace GDBServerFoundation;
+
+	//! Implements debugging functionality without the EEM API (not supporting data breakpoints and software breakpoints).
+	/*!
+		\remarks After creating an instance of this class please call the Initialize() method.
+	*/
+	class MSP430GDBTarget : public ISyncGDBTarget, public IFLASHProgrammer
+	{
+	public:
+		//! Describes the last "load" operation (vFlashErase...vFlashDone sequence)
+		struct FLASHLoadStatistics
+		{
+			unsigned ErasedSegments, UnchangedSegments;
+			//! Segments where the new data only clears bits, so it was programmed without erasing
+			unsigned SegmentsWithoutErase;
+			//! The entire main FLASH was erased with a single MSP430_Erase() call
+			bool MassErase;
+			//! All programmed data was checked with MSP430_VerifyMem() (see \ref fast_load)
+			bool Verified, VerificationFailed;
+			size_t ProgrammedBytes;
+			unsigned ProgrammedBlocks;
+			//! Time spent in each phase of the load (in milliseconds)
+			DWORD EraseTime, ProgramTime, VerifyTime;
+
+			FLASHLoadStatistics()
+			{
+				memset(this, 0, sizeof(*this));
+			}
+		};
+
+	protected:
+		DEVICE_T m_DeviceInfo;
+		bool m_bVerbose;
+
+	private:
+		bool m_bClosePending, m_bValid;
+		//! Set by RegisterSession(). Targets created without a gdb session (e.g. by ProgramImageWithoutGDB()) are never registered.
+		bool m_bSessionRegistered;
+		std::vector<bool> m_UsedBreakpoints;
+		
+		bool m_bFLASHErased, m_bDetached;
+		bool m_b32BitRegisterMode;
+		bool m_bEraseInfoMem;
+		bool m_bStopPrefetch;
+		bool m_bTargetResumed;
+		bool m_bFastLoad;
+		bool m_bPipelinedFLASHLoad;
+		//! Main memory is FRAM (DEVICE_T::HasFramMemroy). It is reported to gdb as RAM and is never erased before programming.
+		bool m_bFRAMMainMemory;
+
+		StopPrefetchProfiler m_PrefetchProfiler;
+
+		FLASHWriteBuffer m_FLASHWriteBuffer;
+		//! Main FLASH ranges requested by vFlashErase. They are erased when the load is committed, skipping the segments that would not change.
+		std::vector<std::pair<unsigned, size_t> > m_PendingFLASHErases;
+		bool m_bFLASHLoadInProgress, m_bFLASHWriteStarted;
+		DWORD m_FLASHLoadStartTime;
+
+		FLASHImageCache *m_pFLASHImageCache;
+
+		FLASHLoadStatistics m_FLASHLoadStats;
+
+		/*! \section fast_load Fast load mode
+			If the --fastload option is specified, RAM_PRESERVE_MODE and VERIFICATION_MODE are disabled from the first FLASH command
+			until vFlashDone. All programmed runs are collected in m_FastLoadRuns and verified with MSP430_VerifyMem() before the modes
+			are restored. As the RAM contents is not preserved, all cached RAM blocks are discarded after the load.
+		*/
+		bool m_bFastLoadActive;
+		std::vector<FLASHWriteBuffer::Run> m_FastLoadRuns;
+
+		/*! \section flash_pipeline Pipelined FLASH programming
+			Unless the entire main FLASH is being reprogrammed (see ErasePendingFLASHSegments()), the segments are programmed
+			by m_pJTAGWorker while the next vFlashWrite packets are being received. A segment is handed over to the worker once
+			gdb writes beyond it. Errors are reported by the next vFlashWrite or by vFlashDone.
+		*/
+		JTAGWorkerThread *m_pJTAGWorker;
+		bool m_bPipelinedLoad, m_bFLASHPipelineFailed;
+		//! Merged main FLASH ranges requested by vFlashErase for the current pipelined load. Read by the worker thread.
+		std::vector<std::pair<unsigned, unsigned> > m_FLASHEraseRanges;
+		//! Images of the segments handed over to the worker. A segment written again by non-ascending vFlashWrite packets is merged with its previous image and reprogrammed as a whole.
+		FLASHWriteBuffer::SegmentMap m_SubmittedFLASHSegments;
+
+		class ProgramSegmentJob;
+		class PrefetchJob;
+
+	private:
+		//! Starts measuring the load time when the first FLASH command of a "load" operation is received
+		void BeginFLASHLoad();
+		//! Discards the state of an unfinished load. gdb does not send vFlashDone after a failed vFlashErase or vFlashWrite.
+		void ResetFLASHLoadState();
+
+		GDBStatus DoEraseFLASH(ULONGLONG addr, size_t length);
+		GDBStatus DoWriteFLASH(ULONGLONG addr, const void *pBuffer, size_t length);
+
+		//! Merges the pending erase requests into sorted segment-aligned [start, end) ranges
+		void MergePendingFLASHErases(std::vector<std::pair<unsigned, unsigned> > &ranges);
+
+		//! Erases the pending main FLASH segments that cannot be programmed with the buffered data without erasing
+		bool ErasePendingFLASHSegments(FLASHLoadStatistics *pStats);
+
+		bool ProgramFLASHRuns(const std::vector<FLASHWriteBuffer::Run> &runs);
+
+		//! Switches the current load to the pipelined mode unless it reprograms the entire main FLASH or the pipeline is disabled (--nopipeline)
+		void StartPipelinedFLASHLoad();
+		void SubmitFLASHSegment(unsigned segmentBase, const FLASHWriteBuffer::Segment &segment);
+		//! Erases (if needed) and programs a single segment. Called on the JTAG worker thread.
+		bool ProgramFLASHSegment(unsigned segmentBase, const FLASHWriteBuffer::Segment &segment);
+
+		//! Enables or disables RAM_PRESERVE_MODE and VERIFICATION_MODE
+		bool SetFLASHSafetyModes(bool enable);
+
+		//! Updates the erase counters after erasing the main FLASH (and the information memory if m_bEraseInfoMem is set) at once
+		void RecordMassFLASHErase();
+
+		//! Restores the FLASH shadow from the image cache after verifying it against the device
+		void LoadFLASHImageCache();
+		void SaveFLASHImageCache();
+
+	protected:
+		bool m_BreakInPending, m_bFLASHCommandsUsed;
+		TargetMemoryCache m_MemoryCache;
+		//! Counts the FLASH erase cycles. NULL if disabled with --nowear or if the device has no FLASH.
+		FLASHWearCounter *m_pWearCounter;
+
+	protected:
+		virtual bool WaitForJTAGEvent();
+		void ReportLastMSP430Error(const char *pHint);
+		virtual bool DoResumeTarget(RUN_MODES_t mode);
+
+		//! Prefetches the memory that gdb has read after the previous stop at the same PC
+		void OnTargetStopped(unsigned pc);
+
+	protected:
+		MSP430GDBTarget()
+			: m_bClosePending(false)
+			, m_bValid(false)
+			, m_bSessionRegistered(false)
+			, m_bVerbose(false)
+			, m_BreakInPending(false)
+			, m_bFLASHErased(false)
+			, m_bDetached(false)
+			, m_bFLASHCommandsUsed(false)
+			, m_b32BitRegisterMode(false)
+			, m_bEraseInfoMem(false)
+			, m_bStopPrefetch(false)
+			, m_bTargetResumed(false)
+			, m_bFastLoad(false)
+			, m_bPipelinedFLASHLoad(false)
+			, m_bFRAMMainMemory(false)
+			, m_bFastLoadActive(false)
+			, m_bFLASHLoadInProgress(false)
+			, m_bFLASHWriteStarted(false)
+			, m_pJTAGWorker(NULL)
+			, m_bPipelinedLoad(false)
+			, m_bFLASHPipelineFailed(false)
+			, m_FLASHLoadStartTime(0)
+			, m_pFLASHImageCache(NULL)
+			, m_pWearCounter(NULL)
+		{
+		}
+	public:
+		~MSP430GDBTarget();
+
+		//! Starts debugging session
+		virtual bool Initialize(const GlobalSettings &settings);
+
+		//! Makes this target the active session that receives the Ctrl+C break-in requests (see GlobalSessionMonitor)
+		/*! \return False if another session is already active. A registered target is unregistered by the destructor. */
+		bool RegisterSession();
+
+		virtual GDBStatus GetLastStopRecord(TargetStopRecord *pRec);
+		virtual GDBStatus ResumeAndWait(int threadID);
+		virtual GDBStatus Step(int threadID);
+		virtual GDBStatus SendBreakInRequestAsync();
+
+		virtual const PlatformRegisterList *GetRegisterList()
+		{
+			if (m_b32BitRegisterMode)
+				return &GDBServerFoundation::MSP430_32bitRegs::RegisterList;
+			else
+				return &GDBServerFoundation::MSP430::RegisterList;
+		}
+
+	public:	//Register accessing API
+		virtual GDBStatus ReadFrameRelatedRegisters(int threadID, RegisterSetContainer &registers);
+		virtual GDBStatus ReadTargetRegisters(int threadID, RegisterSetContainer &registers);
+		virtual GDBStatus WriteTargetRegisters(int threadID, const RegisterSetContainer &registers);
+
+	public: //Memory accessing API
+		virtual GDBStatus ReadTargetMemory(ULONGLONG Address, void *pBuffer, size_t *pSizeInBytes);
+		virtual GDBStatus WriteTargetMemory(ULONGLONG Address, const void *pBuffer, size_t sizeInBytes);
+
+		//! Searches the target memory for the given pattern using large chunked reads (handles the qSearch:memory packet)
+		/*!
+			\param pFoundAddress Receives the address of the first match. If the pattern is not found, it is set to -1.
+		*/
+		GDBStatus SearchTargetMemory(ULONGLONG Address, size_t length, const void *pPattern, size_t patternLength, ULONGLONG *pFoundAddress);
+
+		//! Computes the CRC-32 of the target memory the same way gdb does for the "compare-sections" command (handles the qCRC packet)
+		/*! If the range is covered by the FLASH shadow and the target has not been started yet, the device contents is first checked
+			against the shadow with the device-side checksum, so the CRC can be computed without reading the memory over JTAG.
+			Otherwise the range is read with a single bulk read.
+		*/
+		GDBStatus ComputeTargetMemoryCRC(ULONGLONG Address, size_t length, unsigned *pCRC);
+
+		//! Checks that the device memory contains the given data using MSP430_VerifyMem(). Preserves the CPU registers.
+		/*! The mismatching ranges are reported and removed from the memory cache. */
+		bool VerifyMemoryRuns(const std::vector<FLASHWriteBuffer::Run> &runs);
+
+		//! Writes several memory ranges as a single operation, combining the adjacent RAM writes into larger transfers
+		/*! Unlike the writes received from gdb (see \ref write_combining), the buffered data is sent to the device before returning,
+			so a failed transfer is reported by this call. */
+		GDBStatus WriteTargetMemoryRuns(const std::vector<FLASHWriteBuffer::Run> &runs);
+
+		const FLASHLoadStatistics &GetFLASHLoadStatistics()
+		{
+			return m_FLASHLoadStats;
+		}
+
+		const DEVICE_T &GetDeviceInfo()
+		{
+			return m_DeviceInfo;
+		}
+
+	public:	//Optional methods, can be left unimplemented
+		virtual GDBStatus GetDynamicLibraryList(std::vector<DynamicLibraryRecord> &libraries);
+		virtual GDBStatus GetThreadList(std::vector<ThreadRecord> &threads);
+		virtual GDBStatus SetThreadModeForNextCont(int threadID, DebugThreadMode mode, OUT bool *pNeedRestoreCall, IN OUT INT_PTR *pRestoreCookie);
+		virtual GDBStatus Terminate();
+
+		virtual GDBStatus CreateBreakpoint(BreakpointType type, ULONGLONG Address, unsigned kind, OUT INT_PTR *pCookie);
+		virtual GDBStatus RemoveBreakpoint(BreakpointType type, ULONGLONG Address, INT_PTR Cookie);
+
+		virtual GDBStatus ExecuteRemoteCommand(const std::string &command, std::string &output);
+
+		virtual IFLASHProgrammer *GetFLASHProgrammer() {return this;}
+
+	public:
+		virtual GDBStatus GetEmbeddedMemoryRegions(std::vector<EmbeddedMemoryRegion> &regions);
+		virtual GDBStatus EraseFLASH(ULONGLONG addr, size_t length);
+		virtual GDBStatus WriteFLASH(ULONGLONG addr, const void *pBuffer, size_t length);
+		virtual GDBStatus CommitFLASHWrite();
+		virtual void CloseSessionSafely() {}
+
+		//! Waits until the JTAG worker thread finishes programming
+		/*! The MSP430 API may not be used by the main thread while the worker has pending jobs. MSP430Stub::HandleRequest()
+			calls this method before handling any packet other than vFlashWrite, so the target methods (including the ones
+			overridden by MSP430EEMTarget) never need to call it themselves.
+		*/
+		void WaitForFLASHPipeline();
+
+		//! Restores the FLASH safety modes and discards the buffered data if gdb has aborted a load without sending vFlashDone
+		void DiscardUnfinishedFLASHLoad();
+	};
+}
@@ -1,2 +1,61 @@
-#include "stdafx.h"
-#include "MSP430Util.h"
\ No newline at end of file
+#include "stdafx.h"
+#include "MSP430Util.h"
+
+unsigned UpdateCRC32(unsigned crc, const void *pData, size_t length)
+{
+	static unsigned table[256];
+	static bool tableInitialized = false;
+	if (!tableInitialized)
+	{
+		for (unsigned i = 0; i < 256; i++)
+		{
+			unsigned value = i << 24;
+			for (int bit = 0; bit < 8; bit++)
+				value = (value & 0x80000000) ? ((value << 1) ^ 0x04C11DB7) : (value << 1);
+			table[i] = value;
+		}
+		tableInitialized = true;
+	}
+
+	for (size_t i = 0; i < length; i++)
+		crc = (crc << 8) ^ table[((crc >> 24) ^ ((const unsigned char *)pData)[i]) & 0xFF];
+	return crc;
+}
+
+std::string GetProxyDataDirectory(const char *pDirectory)
+{
+	std::string dir;
+	if (pDirectory && pDirectory[0])
+		dir = pDirectory;
+	else
+	{
+		char szAppData[MAX_PATH] = {0,};
+		if (!GetEnvironmentVariableA("LOCALAPPDATA", szAppData, __countof(szAppData)))
+			GetTempPathA(__countof(szAppData), szAppData);
+		dir = szAppData;
+		if (!dir.empty() && dir[dir.length() - 1] != '\\')
+			dir += '\\';
+		dir += "msp430-gdbproxy";
+	}
+
+	CreateDirectoryA(dir.c_str(), NULL);
+	return dir;
+}
+
+std::string GetPortNameForFileName(const char *pPortName)
+{
+	std::string port = pPortName ? pPortName : "";
+	for (size_t i = 0; i < port.length(); i++)
+		if (!isalnum((unsigned char)port[i]))
+			port[i] = '_';
+	return port;
+}
+
+unsigned GetInfoSegmentSize(const DEVICE_T &device)
+{
+	if (device.cpuArch == CPU_ARCH_XV2)
+		return 128;
+	if (!strncmp((const char *)device.string, "MSP430F1", 8))
+		return 128;
+	return 64;
+}
@@ -1,8 +1,42 @@
-#pragma once
-#include "TI/Inc/msp430.h"
-
-//! Returns the string representation of the last error reported by the MSP430 API
-static const char *GetLastMSP430Error()
-{
-	return MSP430_Error_String(MSP430_Error_Number());
-}
\ No newline at end of file
+#pragma once
+#include "TI/Inc/msp430.h"
+#include <string>
+
+//! Returns the string representation of the last error reported by the MSP430 API
+static const char *GetLastMSP430Error()
+{
+	return MSP430_Error_String(MSP430_Error_Number());
+}
+
+//! Updates the CRC-32 value used by gdb (polynomial 0x04C11DB7, not reflected, initial value 0xFFFFFFFF, no final XOR)
+unsigned UpdateCRC32(unsigned crc, const void *pData, size_t length);
+
+//! Returns the directory for the files persisted between proxy restarts (creating it if needed)
+/*! If pDirectory is NULL or empty, %LOCALAPPDATA%\\msp430-gdbproxy is used. The returned path does not end with a backslash. */
+std::string GetProxyDataDirectory(const char *pDirectory);
+
+//! Returns the size of the information memory segments of the given device
+/*! DEVICE_T only reports the main FLASH segment size, so it is derived from the device family: the 5xx/6xx (CPUXv2) and 1xx devices
+	have 128-byte information segments, the other ones 64-byte segments. The older 4xx devices with 128-byte segments are not recognized,
+	so the erase cycles of their information memory are counted for both 64-byte halves of each segment. */
+unsigned GetInfoSegmentSize(const DEVICE_T &device);
+
+//! Converts a FET port name to a string that can be used in a file name by replacing all non-alphanumeric characters with '_'
+std::string GetPortNameForFileName(const char *pPortName);
+
+//! Returns the amount of physical FLASH segments overlapping [start, end]
+/*! The segments are aligned to the absolute segmentSize boundaries, so the first and the last one can be only partially covered by the range
+	(e.g. the main FLASH of some devices starts in the middle of a segment). */
+static unsigned GetFLASHSegmentCount(unsigned start, unsigned end, unsigned segmentSize)
+{
+	return (end / segmentSize) - (start / segmentSize) + 1;
+}
+
+//! Returns the part of the given physical segment (counted from the one containing 'start') that lies within [start, end] as offsets from 'start'
+static void GetFLASHSegmentBounds(unsigned start, unsigned end, unsigned segmentSize, unsigned index, size_t *pStartOffset, size_t *pEndOffset)
+{
+	unsigned segStart = (start & ~(segmentSize - 1)) + index * segmentSize;
+	unsigned segEnd = segStart + segmentSize;
+	*pStartOffset = (segStart > start) ? (segStart - start) : 0;
+	*pEndOffset = (segEnd < (end + 1)) ? (segEnd - start) : (end + 1 - start);
+}
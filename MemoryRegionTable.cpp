@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "MemoryRegionTable.h"
+
+using namespace MSP430Proxy;
+
+void MSP430Proxy::MemoryRegionTable::AddRegion( const char *pName, unsigned start, unsigned end, unsigned policy, unsigned readAheadSize )
+{
+	if (end < start)
+		return;
+
+	//Memory with side effects should never be accessed more than requested
+	if (policy & rpSideEffects)
+	{
+		policy = rpSideEffects;
+		readAheadSize = 0;
+	}
+	if (!(policy & rpPrefetchable))
+		readAheadSize = 0;
+
+	m_Regions.push_back(MemoryRegion(pName, start, end, policy, readAheadSize));
+}
+
+MSP430Proxy::MemoryRegion * MSP430Proxy::MemoryRegionTable::Find( unsigned addr, size_t length )
+{
+	if (!length)
+		return &m_DefaultRegion;
+
+	for (size_t i = 0; i < m_Regions.size(); i++)
+		if (addr >= m_Regions[i].Start && (addr + length - 1) <= m_Regions[i].End)
+			return &m_Regions[i];
+
+	return &m_DefaultRegion;
+}
+
+static void FormatRegion(std::string &output, const MemoryRegion &region, bool includeCounters)
+{
+	char szPolicy[64] = {0,};
+	if (region.Policy & rpSideEffects)
+		strcat_s(szPolicy, "side-effects ");
+	if (region.Policy & rpCacheable)
+		strcat_s(szPolicy, "cache ");
+	if (region.Policy & rpPrefetchable)
+		strcat_s(szPolicy, "prefetch ");
+	if (region.Policy & rpImmutableWhileHalted)
+		strcat_s(szPolicy, "immutable ");
+	if (region.Policy & rpWriteThrough)
+		strcat_s(szPolicy, "write-through ");
+	if (region.Policy & rpWriteCombining)
+		strcat_s(szPolicy, "write-combine ");
+
+	char szMsg[256];
+	_snprintf_s(szMsg, _TRUNCATE, "%-6s 0x%05x-0x%05x  %s\n", region.pName, region.Start, region.End, szPolicy);
+	output += szMsg;
+
+	if (includeCounters)
+	{
+		_snprintf_s(szMsg, _TRUNCATE, "       %d reads (%I64d bytes, %I64d from device), %d writes (%I64d bytes)\n",
+			region.Reads, region.BytesRead, region.BytesFromDevice, region.Writes, region.BytesWritten);
+		output += szMsg;
+	}
+}
+
+void MSP430Proxy::MemoryRegionTable::Format( std::string &output, bool includeCounters )
+{
+	for (size_t i = 0; i < m_Regions.size(); i++)
+		FormatRegion(output, m_Regions[i], includeCounters);
+	FormatRegion(output, m_DefaultRegion, includeCounters);
+}
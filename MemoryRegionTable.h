@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace MSP430Proxy
+{
+	//! Specifies how the proxy may access a memory region
+	enum MemoryRegionPolicy
+	{
+		//! The memory can be read without side effects, so its contents can be cached while the target is stopped
+		rpCacheable = 0x01,
+		//! The memory can be read speculatively (read-ahead and post-stop prefetch)
+		rpPrefetchable = 0x02,
+		//! The memory can only be modified by the proxy itself, so its cached contents stays valid when the target is resumed
+		rpImmutableWhileHalted = 0x04,
+		//! Reading or writing the memory may change the device state (peripheral registers). Never cached or read speculatively.
+		rpSideEffects = 0x08,
+		//! Written data is stored to the cache after a successful write instead of invalidating it
+		rpWriteThrough = 0x10,
+		//! Adjacent and overlapping writes are merged in the write-combining buffer and sent to the device in one transfer (see TargetMemoryCache::BeginCombinedWrites())
+		rpWriteCombining = 0x20,
+	};
+
+	//! Describes a memory region of the target device and the amount of traffic going to it
+	struct MemoryRegion
+	{
+		const char *pName;
+		unsigned Start, End;
+		unsigned Policy;
+		unsigned ReadAheadSize;
+
+		unsigned Reads, Writes;
+		ULONGLONG BytesRead, BytesWritten, BytesFromDevice;
+
+		MemoryRegion(const char *name, unsigned start, unsigned end, unsigned policy, unsigned readAheadSize)
+			: pName(name)
+			, Start(start)
+			, End(end)
+			, Policy(policy)
+			, ReadAheadSize(readAheadSize)
+			, Reads(0)
+			, Writes(0)
+			, BytesRead(0)
+			, BytesWritten(0)
+			, BytesFromDevice(0)
+		{
+		}
+	};
+
+	//! Classifies target memory accesses by the regions described in DEVICE_T
+	/*! The table is filled when the debugging session starts. Each memory access is dispatched to the region that
+		fully contains it. Accesses that do not fit into any region (e.g. peripheral registers or a read crossing
+		a region boundary) are dispatched to the default region that has the rpSideEffects policy, so they are
+		never cached or read speculatively.
+	*/
+	class MemoryRegionTable
+	{
+	private:
+		std::vector<MemoryRegion> m_Regions;
+		MemoryRegion m_DefaultRegion;
+
+	public:
+		MemoryRegionTable()
+			: m_DefaultRegion("other", 0, 0xFFFFF, rpSideEffects, 0)
+		{
+		}
+
+		void AddRegion(const char *pName, unsigned start, unsigned end, unsigned policy, unsigned readAheadSize = 0);
+
+		//! Returns the region that fully contains the given range. Never returns NULL.
+		MemoryRegion *Find(unsigned addr, size_t length);
+
+		//! Formats the region table. If includeCounters is set, the per-region traffic counters are included.
+		void Format(std::string &output, bool includeCounters);
+	};
+}
@@ -1,252 +1,507 @@
-#include "StdAfx.h"
-#include "SoftwareBreakpointManager.h"
-#include <bzscore/assert.h>
-#include "TI/Inc/MSP430_Debug.h"
-
-using namespace MSP430Proxy;
-
-MSP430Proxy::SoftwareBreakpointManager::SoftwareBreakpointManager( unsigned flashStart, unsigned flashEnd, unsigned short breakInstruction, bool instantCleanup, bool verbose )
-	: m_FlashStart(flashStart)
-	, m_FlashEnd(flashEnd)
-	, m_FlashSize(flashEnd - flashStart + 1)
-	, m_BreakInstruction(breakInstruction)
-	, m_bInstantCleanup(instantCleanup)
-	, m_bVerbose(verbose)
-{
-	ASSERT(!(m_FlashSize & 1));
-	size_t segmentCount = (m_FlashSize + MAIN_SEGMENT_SIZE - 1) / MAIN_SEGMENT_SIZE;
-	m_Segments.resize(segmentCount);
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::SetBreakpoint( unsigned rawAddr )
-{
-	TranslatedAddr addr = TranslateAddress(rawAddr);
-	if (!addr.Valid)
-		return false;
-
-	return m_Segments[addr.Segment].SetBreakpoint(addr.Offset);
-}
-
-MSP430Proxy::SoftwareBreakpointManager::TranslatedAddr MSP430Proxy::SoftwareBreakpointManager::TranslateAddress( unsigned addr )
-{
-	TranslatedAddr result;
-	result.Valid = false;
-
-	addr &= ~1;
-
-	if (addr < m_FlashStart)
-		return result;
-
-	unsigned flashOff = addr - m_FlashStart;
-	if (flashOff >= m_FlashSize)
-		return result;
-
-	result.Segment = flashOff / MAIN_SEGMENT_SIZE;
-	result.Offset = flashOff % MAIN_SEGMENT_SIZE;
-	result.Valid = true;
-
-	return result;
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::RemoveBreakpoint( unsigned rawAddr )
-{
-	TranslatedAddr addr = TranslateAddress(rawAddr);
-	if (!addr.Valid)
-		return false;
-
-	return m_Segments[addr.Segment].RemoveBreakpoint(addr.Offset);
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::SetBreakpoint( unsigned offset )
-{
-	switch(BpState[offset / 2])
-	{
-	case BreakpointActive:
-	case BreakpointPending:
-		return false;	//Breakpoint is already set
-	case BreakpointInactive:
-		InactiveBreakpointCount--;
-		BpState[offset / 2] = BreakpointActive;
-		return true;
-	case NoBreakpoint:
-		PendingBreakpointCount++;
-		BpState[offset / 2] = BreakpointPending;
-		return true;
-	default:
-		return false;
-	}
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::RemoveBreakpoint( unsigned offset )
-{
-	switch(BpState[offset / 2])
-	{
-	case BreakpointActive:
-		InactiveBreakpointCount++;
-		BpState[offset / 2] = BreakpointInactive;
-		return true;
-	case BreakpointPending:
-		PendingBreakpointCount--;
-		BpState[offset / 2] = NoBreakpoint;
-		return true;
-	case BreakpointInactive:
-	case NoBreakpoint:
-		return false;
-	default:
-		return false;
-	}
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::CommitBreakpoints()
-{
-	for (size_t i = 0; i < m_Segments.size(); i++)
-	{
-		if (!m_Segments[i].PendingBreakpointCount)
-		{
-			if (!m_bInstantCleanup || !m_Segments[i].InactiveBreakpointCount)
-				continue;
-		}
-
-		unsigned segBase = m_FlashStart + i * MAIN_SEGMENT_SIZE;
-		unsigned short data[MAIN_SEGMENT_SIZE / 2], data2[MAIN_SEGMENT_SIZE / 2];
-		if (MSP430_Read_Memory(segBase, (char *)data, sizeof(data)) != STATUS_OK)
-			return false;
-
-		bool eraseNeeded = false;
-
-		for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
-		{
-			switch(m_Segments[i].BpState[j])
-			{
-			case BreakpointInactive:
-				m_Segments[i].BpState[j] = NoBreakpoint;
-				data[j] = m_Segments[i].OriginalInstructions[j];
-				eraseNeeded = true;
-				if (m_bVerbose)
-					printf("Restoring original FLASH instruction at 0x%x\n", segBase + j * 2);
-				break;
-			case BreakpointPending:
-				m_Segments[i].BpState[j] = BreakpointActive;
-				m_Segments[i].OriginalInstructions[j] = data[j];
-				
-				if ((data[j] & m_BreakInstruction) != m_BreakInstruction)
-					eraseNeeded = true;
-
-				if (m_bVerbose)
-					printf("Inserting a FLASH breakpoint at 0x%x, sector erase %s\n", segBase + j * 2, eraseNeeded ? "pending" : "not pending");
-
-				data[j] = m_BreakInstruction;
-				break;
-			}
-		}
-
-		for (;;)
-		{
-			if (eraseNeeded)
-			{
-				if (m_bVerbose)
-					printf("Erasing FLASH segment at 0x%x-0x%x\n", segBase, segBase + sizeof(data) - 1);
-
-				if (MSP430_Erase(ERASE_SEGMENT, segBase, sizeof(data)) != STATUS_OK)
-					return false;
-			}
-
-			if (MSP430_Write_Memory(segBase, (char *)data, sizeof(data)) != STATUS_OK)
-				return false;
-
-			if (MSP430_Read_Memory(segBase, (char *)data2, sizeof(data2)) != STATUS_OK)
-				return false;
-
-			if (memcmp(data, data2, sizeof(data)))
-			{
-				if (!eraseNeeded)
-				{
-					eraseNeeded = true;
-					continue;
-				}
-				return false;
-			}
-
-			break;
-		}
-
-		m_Segments[i].PendingBreakpointCount = 0;
-		m_Segments[i].InactiveBreakpointCount = 0;
-	}
-
-	return true;
-}
-
-MSP430Proxy::SoftwareBreakpointManager::BreakpointState MSP430Proxy::SoftwareBreakpointManager::GetBreakpointState( unsigned rawAddr )
-{
-	TranslatedAddr addr = TranslateAddress(rawAddr);
-	if (!addr.Valid)
-		return NoBreakpoint;
-
-	return (BreakpointState)m_Segments[addr.Segment].BpState[addr.Offset / 2];
-}
-
-bool MSP430Proxy::SoftwareBreakpointManager::GetOriginalInstruction( unsigned rawAddr, unsigned short *pInsn )
-{
-	TranslatedAddr addr = TranslateAddress(rawAddr);
-	if (!addr.Valid)
-		return false;
-
-	switch (m_Segments[addr.Segment].BpState[addr.Offset / 2])
-	{
-	case BreakpointActive:
-	case BreakpointInactive:
-		*pInsn = m_Segments[addr.Segment].OriginalInstructions[addr.Offset / 2];
-		return true;
-	default:
-		return false;
-	}
-}
-
-void MSP430Proxy::SoftwareBreakpointManager::HideOrRestoreBreakpointsInMemorySnapshot( unsigned addr, void *pBlock, size_t length, bool hideBreakpoints )
-{
-	//Adjust pBlock so that it starts inside the FLASH region or past it
-	if (addr < m_FlashStart)
-	{
-		unsigned delta = m_FlashStart - addr;
-
-		if (delta >= length)
-			return;	//Nothing to do, the block does not cover any FLASH addresses
-
-		addr += delta;
-		length -= delta;
-		pBlock = ((char *)pBlock + delta);
-	}
-
-	int bufferOffsetInFlash = addr - m_FlashStart;
-
-	size_t indexInBlock = 0;
-	for (size_t seg = bufferOffsetInFlash / MAIN_SEGMENT_SIZE; seg < m_Segments.size(); seg++)
-	{
-		unsigned baseAddr = m_FlashStart + seg * MAIN_SEGMENT_SIZE;
-
-		size_t i = 0;
-		if (baseAddr < addr)
-			i = addr - baseAddr;	//First segment covered by the block
-
-		while (i < MAIN_SEGMENT_SIZE)
-		{
-			if (indexInBlock >= length)
-				return;
-
-			switch(m_Segments[seg].BpState[i / 2])
-			{
-			case BreakpointActive:
-			case BreakpointInactive:
-				if (hideBreakpoints)
-					((char *)pBlock)[indexInBlock] = ((char *)m_Segments[seg].OriginalInstructions)[i];
-				else
-					((char *)m_Segments[seg].OriginalInstructions)[i] = ((char *)pBlock)[indexInBlock];
-				break;
-			}
-
-			i++;
-			indexInBlock++;
-		}
-	}
-}
+#include "StdAfx.h"
+#include "SoftwareBreakpointManager.h"
+#include "TargetMemoryCache.h"
+#include "FLASHWearCounter.h"
+#include <bzscore/assert.h>
+#include "TI/Inc/MSP430_Debug.h"
+#include <algorithm>
+
+using namespace MSP430Proxy;
+
+MSP430Proxy::SoftwareBreakpointManager::SoftwareBreakpointManager( unsigned flashStart, unsigned flashEnd, unsigned short breakInstruction, TargetMemoryCache *pMemoryCache, FLASHWearCounter *pWearCounter, bool instantCleanup, bool verbose )
+	: m_FlashStart(flashStart)
+	, m_FlashEnd(flashEnd)
+	, m_FlashSize(flashEnd - flashStart + 1)
+	, m_SegmentGridStart(flashStart & ~(MAIN_SEGMENT_SIZE - 1))
+	, m_BreakInstruction(breakInstruction)
+	, m_pMemoryCache(pMemoryCache)
+	, m_pWearCounter(pWearCounter)
+	, m_bInstantCleanup(instantCleanup)
+	, m_bVerbose(verbose)
+{
+	ASSERT(!(m_FlashSize & 1));
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::SetBreakpoint( unsigned rawAddr )
+{
+	TranslatedAddr addr = TranslateAddress(rawAddr);
+	if (!addr.Valid)
+		return false;
+
+	SegmentRecord &segment = m_Segments[addr.Segment];
+	if (!segment.SetBreakpoint(addr.Offset))
+		return false;
+
+	UpdateDirtyState(addr.Segment, segment);
+	return true;
+}
+
+MSP430Proxy::SoftwareBreakpointManager::TranslatedAddr MSP430Proxy::SoftwareBreakpointManager::TranslateAddress( unsigned addr )
+{
+	TranslatedAddr result;
+	result.Valid = false;
+
+	addr &= ~1;
+
+	if (addr < m_FlashStart)
+		return result;
+
+	unsigned flashOff = addr - m_FlashStart;
+	if (flashOff >= m_FlashSize)
+		return result;
+
+	result.Segment = (addr - m_SegmentGridStart) / MAIN_SEGMENT_SIZE;
+	result.Offset = (addr - m_SegmentGridStart) % MAIN_SEGMENT_SIZE;
+	result.Valid = true;
+
+	return result;
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::RemoveBreakpoint( unsigned rawAddr )
+{
+	TranslatedAddr addr = TranslateAddress(rawAddr);
+	if (!addr.Valid)
+		return false;
+
+	SegmentMap::iterator it = m_Segments.find(addr.Segment);
+	if (it == m_Segments.end())
+		return false;
+
+	if (!it->second.RemoveBreakpoint(addr.Offset))
+		return false;
+
+	UpdateDirtyState(addr.Segment, it->second);
+	if (it->second.IsEmpty())
+		m_Segments.erase(it);
+	return true;
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::GetOriginalInstruction( unsigned index, unsigned short *pInsn ) const
+{
+	std::vector<SavedInstruction>::const_iterator it = std::lower_bound(OriginalInstructions.begin(), OriginalInstructions.end(), index, CompareIndex);
+	if (it == OriginalInstructions.end() || it->Index != index)
+		return false;
+
+	*pInsn = it->Instruction;
+	return true;
+}
+
+void MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::SetOriginalInstruction( unsigned index, unsigned short insn )
+{
+	std::vector<SavedInstruction>::iterator it = std::lower_bound(OriginalInstructions.begin(), OriginalInstructions.end(), index, CompareIndex);
+	if (it != OriginalInstructions.end() && it->Index == index)
+	{
+		it->Instruction = insn;
+		return;
+	}
+
+	SavedInstruction entry = {(unsigned short)index, insn};
+	OriginalInstructions.insert(it, entry);
+}
+
+void MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::ForgetOriginalInstruction( unsigned index )
+{
+	std::vector<SavedInstruction>::iterator it = std::lower_bound(OriginalInstructions.begin(), OriginalInstructions.end(), index, CompareIndex);
+	if (it != OriginalInstructions.end() && it->Index == index)
+		OriginalInstructions.erase(it);
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::SetBreakpoint( unsigned offset )
+{
+	switch(GetState(offset / 2))
+	{
+	case BreakpointActive:
+	case BreakpointPending:
+		return false;	//Breakpoint is already set
+	case BreakpointInactive:
+		InactiveBreakpointCount--;
+		ActiveBreakpointCount++;
+		SetState(offset / 2, BreakpointActive);
+		return true;
+	case NoBreakpoint:
+		PendingBreakpointCount++;
+		SetState(offset / 2, BreakpointPending);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::SegmentRecord::RemoveBreakpoint( unsigned offset )
+{
+	unsigned short insn;
+	switch(GetState(offset / 2))
+	{
+	case BreakpointActive:
+		ActiveBreakpointCount--;
+		InactiveBreakpointCount++;
+		SetState(offset / 2, BreakpointInactive);
+		return true;
+	case BreakpointPending:
+		PendingBreakpointCount--;
+		if (GetOriginalInstruction(offset / 2, &insn))
+		{
+			//A failed commit may have already programmed the breakpoint instruction, so it should be removed like an active one
+			InactiveBreakpointCount++;
+			SetState(offset / 2, BreakpointInactive);
+		}
+		else
+			SetState(offset / 2, NoBreakpoint);
+		return true;
+	case BreakpointInactive:
+	case NoBreakpoint:
+		return false;
+	default:
+		return false;
+	}
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::CommitBreakpoints()
+{
+	bool succeeded = CommitDirtySegments();
+	if (m_pWearCounter)
+		m_pWearCounter->SaveIfModified();
+	return succeeded;
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::CommitDirtySegments()
+{
+	//Only the segments modified since the last commit are visited, so a commit without changes does not depend on the amount of breakpoints
+	while (!m_DirtySegments.empty())
+	{
+		unsigned segmentIndex = *m_DirtySegments.begin();
+		SegmentMap::iterator it = m_Segments.find(segmentIndex);
+		ASSERT(it != m_Segments.end());
+
+		SegmentRecord &segment = it->second;
+		unsigned segBase = m_SegmentGridStart + segmentIndex * MAIN_SEGMENT_SIZE;
+
+		//The first and the last segment are partial if the FLASH does not start or end on a segment boundary.
+		//The words outside the FLASH are kept at 0xFFFF, so they are never programmed.
+		unsigned firstWord = (segBase < m_FlashStart) ? (m_FlashStart - segBase) / 2 : 0;
+		unsigned lastWord = ((m_FlashEnd + 1 - segBase) < MAIN_SEGMENT_SIZE) ? (m_FlashEnd + 1 - segBase) / 2 : MAIN_SEGMENT_SIZE / 2;
+		unsigned partStart = segBase + firstWord * 2;
+		size_t partLength = (lastWord - firstWord) * 2;
+
+		unsigned short data[MAIN_SEGMENT_SIZE / 2], oldData[MAIN_SEGMENT_SIZE / 2];
+		bool eraseNeeded = false, fromShadow = false;
+
+		std::map<unsigned, std::vector<unsigned short> >::iterator interrupted = m_InterruptedSegments.find(segmentIndex);
+		if (interrupted != m_InterruptedSegments.end())
+		{
+			//The device contents is incomplete, so the segment is erased and programmed again from the saved contents
+			memcpy(data, &interrupted->second[0], sizeof(data));
+			eraseNeeded = true;
+		}
+		else
+		{
+			//The FLASH shadow is stale if the FLASH was modified behind the proxy, so the contents taken from it is checked before programming
+			fromShadow = m_pMemoryCache->IsFLASHShadowLoaded(partStart, partLength);
+			memset(data, 0xFF, sizeof(data));
+			if (!m_pMemoryCache->ReadMemory(partStart, data + firstWord, partLength))
+				return false;
+		}
+		memcpy(oldData, data, sizeof(data));
+
+		unsigned short originalInsn;
+		bool savedOriginal[MAIN_SEGMENT_SIZE / 2] = {false, };
+
+		//The breakpoint states are only updated once the segment is programmed, so that a failed commit is fully retried next time
+		for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+		{
+			switch(segment.GetState(j))
+			{
+			case BreakpointInactive:
+				segment.GetOriginalInstruction(j, &data[j]);
+				eraseNeeded = true;
+				if (m_bVerbose)
+					printf("Restoring original FLASH instruction at 0x%x\n", segBase + j * 2);
+				break;
+			case BreakpointPending:
+				//If a previous commit of this segment failed, the FLASH may already contain the breakpoint instruction instead of the original one
+				if (!segment.GetOriginalInstruction(j, &originalInsn))
+				{
+					segment.SetOriginalInstruction(j, data[j]);
+					savedOriginal[j] = true;
+				}
+
+				if ((data[j] & m_BreakInstruction) != m_BreakInstruction)
+					eraseNeeded = true;
+
+				if (m_bVerbose)
+					printf("Inserting a FLASH breakpoint at 0x%x, sector erase %s\n", segBase + j * 2, eraseNeeded ? "pending" : "not pending");
+
+				data[j] = m_BreakInstruction;
+				break;
+			}
+		}
+
+		m_pMemoryCache->Invalidate(partStart, partLength);
+
+		bool shadowMatches = true;
+		for (;;)
+		{
+			if (fromShadow)
+			{
+				//Programming without an erase relies on the old contents of the modified words, an erase relies on the entire segment
+				bool checkMask[MAIN_SEGMENT_SIZE / 2];
+				for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+					checkMask[j] = (j >= firstWord && j < lastWord) && (eraseNeeded || data[j] != oldData[j]);
+
+				if (!CompareWords(segBase, oldData, checkMask, &shadowMatches))
+					return false;
+				fromShadow = false;
+				if (!shadowMatches)
+					break;
+			}
+
+			//Without an erase only the modified words need programming. After an erase the words left at 0xFFFF are already correct.
+			bool writeMask[MAIN_SEGMENT_SIZE / 2];
+			if (eraseNeeded)
+			{
+				if (m_bVerbose)
+					printf("Erasing FLASH segment at 0x%x-0x%x\n", partStart, partStart + partLength - 1);
+
+				if (interrupted == m_InterruptedSegments.end())
+					interrupted = m_InterruptedSegments.insert(std::make_pair(segmentIndex, std::vector<unsigned short>(oldData, oldData + MAIN_SEGMENT_SIZE / 2))).first;
+
+				if (MSP430_Erase(ERASE_SEGMENT, partStart, partLength) != STATUS_OK)
+					return false;
+				if (m_pWearCounter)
+					m_pWearCounter->OnSegmentsErased(partStart, partLength);
+
+				for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+					writeMask[j] = (data[j] != 0xFFFF);
+			}
+			else
+			{
+				for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+					writeMask[j] = (data[j] != oldData[j]);
+			}
+
+			bool verified = false;
+			if (!ProgramWords(segBase, data, writeMask, &verified))
+				return false;
+
+			if (!verified)
+			{
+				if (!eraseNeeded)
+				{
+					eraseNeeded = true;
+					continue;
+				}
+				return false;
+			}
+
+			break;
+		}
+
+		if (!shadowMatches)
+		{
+			//Nothing was programmed yet. The shadow segment is already invalidated, so the segment is processed again from the device contents.
+			printf("FLASH segment at 0x%x was modified outside of the debugger, reloading it from the device\n", partStart);
+			for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+				if (savedOriginal[j])
+					segment.ForgetOriginalInstruction(j);
+			continue;
+		}
+
+		m_pMemoryCache->Store(partStart, data + firstWord, partLength);
+		if (interrupted != m_InterruptedSegments.end())
+			m_InterruptedSegments.erase(interrupted);
+
+		for (size_t j = 0; j < MAIN_SEGMENT_SIZE / 2; j++)
+		{
+			switch(segment.GetState(j))
+			{
+			case BreakpointInactive:
+				segment.SetState(j, NoBreakpoint);
+				segment.ForgetOriginalInstruction(j);
+				break;
+			case BreakpointPending:
+				segment.SetState(j, BreakpointActive);
+				segment.ActiveBreakpointCount++;
+				break;
+			}
+		}
+
+		segment.PendingBreakpointCount = 0;
+		segment.InactiveBreakpointCount = 0;
+
+		m_DirtySegments.erase(segmentIndex);
+		if (segment.IsEmpty())
+			m_Segments.erase(it);
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::ProgramWords( unsigned segBase, const unsigned short *pData, const bool *pWriteMask, bool *pVerified )
+{
+	*pVerified = true;
+	for (size_t start = 0; start < MAIN_SEGMENT_SIZE / 2; )
+	{
+		if (!pWriteMask[start])
+		{
+			start++;
+			continue;
+		}
+
+		size_t end = start + 1;
+		while (end < MAIN_SEGMENT_SIZE / 2 && pWriteMask[end])
+			end++;
+
+		unsigned short readBack[MAIN_SEGMENT_SIZE / 2];
+		unsigned addr = segBase + start * 2;
+		size_t byteCount = (end - start) * 2;
+
+		if (MSP430_Write_Memory(addr, (char *)(pData + start), byteCount) != STATUS_OK)
+			return false;
+		if (MSP430_Read_Memory(addr, (char *)readBack, byteCount) != STATUS_OK)
+			return false;
+
+		if (memcmp(pData + start, readBack, byteCount))
+		{
+			*pVerified = false;
+			return true;
+		}
+
+		start = end;
+	}
+
+	return true;
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::CompareWords( unsigned segBase, const unsigned short *pExpected, const bool *pMask, bool *pMatches )
+{
+	*pMatches = true;
+	for (size_t start = 0; start < MAIN_SEGMENT_SIZE / 2; )
+	{
+		if (!pMask[start])
+		{
+			start++;
+			continue;
+		}
+
+		size_t end = start + 1;
+		while (end < MAIN_SEGMENT_SIZE / 2 && pMask[end])
+			end++;
+
+		unsigned short deviceData[MAIN_SEGMENT_SIZE / 2];
+		size_t byteCount = (end - start) * 2;
+		if (MSP430_Read_Memory(segBase + start * 2, (char *)deviceData, byteCount) != STATUS_OK)
+			return false;
+
+		if (memcmp(pExpected + start, deviceData, byteCount))
+		{
+			*pMatches = false;
+			return true;
+		}
+
+		start = end;
+	}
+
+	return true;
+}
+
+MSP430Proxy::SoftwareBreakpointManager::BreakpointState MSP430Proxy::SoftwareBreakpointManager::GetBreakpointState( unsigned rawAddr )
+{
+	TranslatedAddr addr = TranslateAddress(rawAddr);
+	if (!addr.Valid)
+		return NoBreakpoint;
+
+	SegmentMap::iterator it = m_Segments.find(addr.Segment);
+	if (it == m_Segments.end())
+		return NoBreakpoint;
+
+	return it->second.GetState(addr.Offset / 2);
+}
+
+bool MSP430Proxy::SoftwareBreakpointManager::GetOriginalInstruction( unsigned rawAddr, unsigned short *pInsn )
+{
+	TranslatedAddr addr = TranslateAddress(rawAddr);
+	if (!addr.Valid)
+		return false;
+
+	SegmentMap::iterator it = m_Segments.find(addr.Segment);
+	if (it == m_Segments.end())
+		return false;
+
+	switch (it->second.GetState(addr.Offset / 2))
+	{
+	case BreakpointActive:
+	case BreakpointInactive:
+		return it->second.GetOriginalInstruction(addr.Offset / 2, pInsn);
+	default:
+		return false;
+	}
+}
+
+size_t MSP430Proxy::SoftwareBreakpointManager::GetSegmentMapSize( size_t *pRecordCount )
+{
+	size_t totalSize = 0;
+	for (SegmentMap::iterator it = m_Segments.begin(); it != m_Segments.end(); it++)
+		totalSize += sizeof(*it) + it->second.OriginalInstructions.capacity() * sizeof(SegmentRecord::SavedInstruction);
+
+	if (pRecordCount)
+		*pRecordCount = m_Segments.size();
+	return totalSize;
+}
+
+void MSP430Proxy::SoftwareBreakpointManager::HideOrRestoreBreakpointsInMemorySnapshot( unsigned addr, void *pBlock, size_t length, bool hideBreakpoints )
+{
+	//Adjust pBlock so that it starts inside the FLASH region or past it
+	if (addr < m_FlashStart)
+	{
+		unsigned delta = m_FlashStart - addr;
+
+		if (delta >= length)
+			return;	//Nothing to do, the block does not cover any FLASH addresses
+
+		addr += delta;
+		length -= delta;
+		pBlock = ((char *)pBlock + delta);
+	}
+
+	if (addr > m_FlashEnd)
+		return;
+
+	unsigned endAddr = addr + length;
+	if (endAddr > (m_FlashEnd + 1))
+		endAddr = m_FlashEnd + 1;
+
+	for (SegmentMap::iterator segIt = m_Segments.lower_bound((addr - m_SegmentGridStart) / MAIN_SEGMENT_SIZE); segIt != m_Segments.end(); segIt++)
+	{
+		unsigned baseAddr = m_SegmentGridStart + segIt->first * MAIN_SEGMENT_SIZE;
+		if (baseAddr >= endAddr)
+			break;
+
+		SegmentRecord &segment = segIt->second;
+		if (!segment.ActiveBreakpointCount && !segment.InactiveBreakpointCount)
+			continue;	//No breakpoints are physically present in this segment
+
+		unsigned start = (baseAddr > addr) ? baseAddr : addr;
+		unsigned end = ((baseAddr + MAIN_SEGMENT_SIZE) < endAddr) ? (baseAddr + MAIN_SEGMENT_SIZE) : endAddr;
+
+		std::vector<SegmentRecord::SavedInstruction>::iterator it = std::lower_bound(segment.OriginalInstructions.begin(), segment.OriginalInstructions.end(), (start - baseAddr) / 2, SegmentRecord::CompareIndex);
+		for (; it != segment.OriginalInstructions.end(); it++)
+		{
+			unsigned wordAddr = baseAddr + it->Index * 2;
+			if (wordAddr >= end)
+				break;
+
+			for (unsigned byteAddr = wordAddr; byteAddr < (wordAddr + 2); byteAddr++)
+			{
+				if (byteAddr < start || byteAddr >= end)
+					continue;
+
+				char *pByte = (char *)pBlock + (byteAddr - addr);
+				char *pOriginalByte = (char *)&it->Instruction + (byteAddr - wordAddr);
+				if (hideBreakpoints)
+					*pByte = *pOriginalByte;
+				else
+					*pOriginalByte = *pByte;
+			}
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#include "stdafx.h"
+#include "StopPrefetchProfiler.h"
+#include <algorithm>
+
+using namespace MSP430Proxy;
+
+static bool CompareRangeStart(const StopPrefetchProfiler::Range &left, const StopPrefetchProfiler::Range &right)
+{
+	return left.Start < right.Start;
+}
+
+void MSP430Proxy::StopPrefetchProfiler::SaveRecordedProfile()
+{
+	if (!m_bRecording)
+		return;
+	m_bRecording = false;
+
+	if (m_RecordedReads.empty())
+	{
+		m_Profiles.erase(m_StopPC);
+		return;
+	}
+
+	std::sort(m_RecordedReads.begin(), m_RecordedReads.end(), CompareRangeStart);
+
+	std::vector<Range> merged;
+	for (size_t i = 0; i < m_RecordedReads.size(); i++)
+	{
+		const Range &range = m_RecordedReads[i];
+		if (!merged.empty())
+		{
+			Range &last = merged.back();
+			unsigned lastEnd = last.Start + last.Length;
+			if (range.Start <= (lastEnd + MERGE_GAP) && (range.Start + range.Length - last.Start) <= MAX_MERGED_RANGE)
+			{
+				if ((range.Start + range.Length) > lastEnd)
+					last.Length = range.Start + range.Length - last.Start;
+				continue;
+			}
+		}
+
+		merged.push_back(range);
+	}
+
+	if (m_Profiles.size() >= MAX_PROFILES && m_Profiles.find(m_StopPC) == m_Profiles.end())
+		m_Profiles.erase(m_Profiles.begin());
+
+	m_Profiles[m_StopPC] = merged;
+}
+
+void MSP430Proxy::StopPrefetchProfiler::OnTargetStopped( unsigned pc, std::vector<Range> *pRangesToPrefetch )
+{
+	SaveRecordedProfile();
+
+	ProfileMap::iterator it = m_Profiles.find(pc);
+	if (it != m_Profiles.end())
+		*pRangesToPrefetch = it->second;
+	else
+		pRangesToPrefetch->clear();
+
+	m_StopPC = pc;
+	m_RecordedReads.clear();
+	m_bRecording = true;
+}
+
+void MSP430Proxy::StopPrefetchProfiler::OnTargetResumed()
+{
+	SaveRecordedProfile();
+}
+
+void MSP430Proxy::StopPrefetchProfiler::OnMemoryRead( unsigned addr, size_t length )
+{
+	//Large reads come from bulk operations (e.g. memory search) rather than from inspecting the stopped program
+	if (!m_bRecording || !length || length > MAX_MERGED_RANGE)
+		return;
+
+	Range range = {addr, length};
+	m_RecordedReads.push_back(range);
+
+	if (m_RecordedReads.size() >= MAX_RECORDED_READS)
+		SaveRecordedProfile();
+}
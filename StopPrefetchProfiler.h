@@ -0,0 +1,59 @@
+#pragma once
+#include <map>
+#include <vector>
+
+namespace MSP430Proxy
+{
+	//! Learns which memory ranges gdb reads after the target stops at a given PC
+	/*! After each breakpoint hit gdb front ends typically read an almost identical set of memory ranges (the frame around SP,
+		some global variables, the vector table). This class records the ranges read by the first MAX_RECORDED_READS requests
+		after each stop and stores them keyed by the stop PC. When the target stops at the same PC again, the recorded ranges
+		are merged and returned by OnTargetStopped(), so that they can be fetched into the memory cache in a few bulk reads
+		before gdb asks for them.
+	*/
+	class StopPrefetchProfiler
+	{
+	public:
+		struct Range
+		{
+			unsigned Start;
+			size_t Length;
+		};
+
+	private:
+		enum
+		{
+			MAX_RECORDED_READS = 32,
+			MAX_PROFILES = 256,
+			//! Ranges separated by less than this amount of bytes are fetched with a single read
+			MERGE_GAP = 32,
+			MAX_MERGED_RANGE = 1024,
+		};
+
+		typedef std::map<unsigned, std::vector<Range> > ProfileMap;
+		ProfileMap m_Profiles;
+
+		bool m_bRecording;
+		unsigned m_StopPC;
+		std::vector<Range> m_RecordedReads;
+
+	private:
+		void SaveRecordedProfile();
+
+	public:
+		StopPrefetchProfiler()
+			: m_bRecording(false)
+			, m_StopPC(0)
+		{
+		}
+
+		//! Starts recording a new profile and returns the ranges that were read after the previous stop at the same PC
+		void OnTargetStopped(unsigned pc, std::vector<Range> *pRangesToPrefetch);
+
+		//! Finishes the current recording (if any)
+		void OnTargetResumed();
+
+		//! Records a memory read request coming from gdb
+		void OnMemoryRead(unsigned addr, size_t length);
+	};
+}
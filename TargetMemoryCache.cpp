@@ -0,0 +1,487 @@
+#include "stdafx.h"
+#include "TargetMemoryCache.h"
+#include "TI/Inc/MSP430.h"
+#include "MSP430Util.h"
+
+using namespace MSP430Proxy;
+
+void MSP430Proxy::TargetMemoryCache::AddRegion( const char *pName, unsigned start, unsigned end, unsigned policy, unsigned readAheadSize )
+{
+	//The read-ahead blocks are aligned, so the size should be a power of 2
+	if (readAheadSize > MAX_READ_AHEAD_SIZE)
+		readAheadSize = MAX_READ_AHEAD_SIZE;
+	while (readAheadSize & (readAheadSize - 1))
+		readAheadSize &= readAheadSize - 1;
+
+	m_Regions.AddRegion(pName, start, end, policy, readAheadSize);
+}
+
+bool MSP430Proxy::TargetMemoryCache::Lookup( unsigned addr, void *pBuffer, size_t length, unsigned epoch )
+{
+	for (size_t done = 0; done < length; )
+	{
+		unsigned blockAddr = (unsigned)(addr + done) & ~(BLOCK_SIZE - 1);
+		unsigned offset = (unsigned)(addr + done) - blockAddr;
+		size_t todo = BLOCK_SIZE - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		BlockMap::iterator it = m_Blocks.find(blockAddr);
+		if (it == m_Blocks.end() || it->second.Epoch != epoch)
+			return false;
+
+		ULONGLONG mask = MakeMask(offset, todo);
+		if ((it->second.ValidMask & mask) != mask)
+			return false;
+
+		memcpy((char *)pBuffer + done, it->second.Data + offset, todo);
+		done += todo;
+	}
+
+	return true;
+}
+
+void MSP430Proxy::TargetMemoryCache::StoreBlocks( unsigned addr, const void *pData, size_t length, unsigned epoch )
+{
+	for (size_t done = 0; done < length; )
+	{
+		unsigned blockAddr = (unsigned)(addr + done) & ~(BLOCK_SIZE - 1);
+		unsigned offset = (unsigned)(addr + done) - blockAddr;
+		size_t todo = BLOCK_SIZE - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		Block &block = m_Blocks[blockAddr];
+		if (block.Epoch != epoch)
+		{
+			block.Epoch = epoch;
+			block.ValidMask = 0;
+		}
+
+		memcpy(block.Data + offset, (const char *)pData + done, todo);
+		block.ValidMask |= MakeMask(offset, todo);
+		done += todo;
+	}
+}
+
+void MSP430Proxy::TargetMemoryCache::InvalidateBlocks( unsigned addr, size_t length )
+{
+	for (size_t done = 0; done < length; )
+	{
+		unsigned blockAddr = (unsigned)(addr + done) & ~(BLOCK_SIZE - 1);
+		unsigned offset = (unsigned)(addr + done) - blockAddr;
+		size_t todo = BLOCK_SIZE - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		BlockMap::iterator it = m_Blocks.find(blockAddr);
+		if (it != m_Blocks.end())
+			it->second.ValidMask &= ~MakeMask(offset, todo);
+
+		done += todo;
+	}
+}
+
+void MSP430Proxy::TargetMemoryCache::EnableFLASHShadow( unsigned start, unsigned end, unsigned segmentSize )
+{
+	if (end < start || !segmentSize)
+		return;
+
+	m_ShadowStart = start;
+	m_ShadowEnd = end;
+	m_ShadowSegmentSize = segmentSize;
+	m_ShadowImage.resize(end - start + 1);
+	m_ShadowSegmentValid.assign(GetFLASHSegmentCount(start, end, segmentSize), false);
+}
+
+void MSP430Proxy::TargetMemoryCache::GetShadowSegmentBounds( unsigned seg, size_t *pStart, size_t *pEnd )
+{
+	GetFLASHSegmentBounds(m_ShadowStart, m_ShadowEnd, m_ShadowSegmentSize, seg, pStart, pEnd);
+}
+
+bool MSP430Proxy::TargetMemoryCache::GetShadowIntersection( unsigned addr, size_t length, unsigned *pStart, unsigned *pEnd )
+{
+	if (m_ShadowImage.empty() || !length)
+		return false;
+	if (addr > m_ShadowEnd || (addr + length) <= m_ShadowStart)
+		return false;
+
+	*pStart = (addr > m_ShadowStart) ? addr : m_ShadowStart;
+	*pEnd = ((addr + length) < (m_ShadowEnd + 1)) ? (unsigned)(addr + length) : (m_ShadowEnd + 1);
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::ReadFromShadow( unsigned addr, void *pBuffer, size_t length )
+{
+	unsigned firstSeg = GetShadowSegment(addr);
+	unsigned lastSeg = GetShadowSegment((unsigned)(addr + length - 1));
+	bool allValid = true;
+
+	for (unsigned seg = firstSeg; seg <= lastSeg; seg++)
+	{
+		if (m_ShadowSegmentValid[seg])
+			continue;
+
+		//Load all consecutive missing segments with a single read
+		unsigned runEnd = seg;
+		while (runEnd < lastSeg && !m_ShadowSegmentValid[runEnd + 1])
+			runEnd++;
+
+		size_t offset, runStop, unused;
+		GetShadowSegmentBounds(seg, &offset, &unused);
+		GetShadowSegmentBounds(runEnd, &unused, &runStop);
+		size_t runLength = runStop - offset;
+
+		if (MSP430_Read_Memory(m_ShadowStart + offset, (char *)&m_ShadowImage[offset], runLength) != STATUS_OK)
+			return false;
+
+		for (unsigned i = seg; i <= runEnd; i++)
+			m_ShadowSegmentValid[i] = true;
+
+		m_Stats.BytesFromDevice += runLength;
+		allValid = false;
+		seg = runEnd;
+	}
+
+	memcpy(pBuffer, &m_ShadowImage[addr - m_ShadowStart], length);
+
+	if (allValid)
+	{
+		m_Stats.Hits++;
+		m_Stats.BytesFromCache += length;
+	}
+	else
+		m_Stats.Misses++;
+
+	return true;
+}
+
+void MSP430Proxy::TargetMemoryCache::StoreToShadow( unsigned addr, const void *pData, size_t length )
+{
+	for (size_t done = 0; done < length; )
+	{
+		size_t offset = addr + done - m_ShadowStart;
+		unsigned seg = GetShadowSegment((unsigned)(addr + done));
+		size_t segStart, segEnd;
+		GetShadowSegmentBounds(seg, &segStart, &segEnd);
+		size_t segLength = segEnd - segStart;
+
+		size_t todo = segEnd - offset;
+		if (todo > (length - done))
+			todo = length - done;
+
+		//Partially written segments can only be updated if the rest of the segment is already known
+		if (todo == segLength)
+			m_ShadowSegmentValid[seg] = true;
+		if (m_ShadowSegmentValid[seg])
+			memcpy(&m_ShadowImage[offset], (const char *)pData + done, todo);
+
+		done += todo;
+	}
+}
+
+void MSP430Proxy::TargetMemoryCache::Store( unsigned addr, const void *pData, size_t length )
+{
+	const MemoryRegion *pRegion = m_Regions.Find(addr, length);
+	if (!(pRegion->Policy & rpCacheable))
+	{
+		Invalidate(addr, length);
+		return;
+	}
+
+	unsigned epoch = GetEpoch(pRegion);
+	unsigned shadowStart, shadowEnd;
+	if (!GetShadowIntersection(addr, length, &shadowStart, &shadowEnd))
+	{
+		StoreBlocks(addr, pData, length, epoch);
+		return;
+	}
+
+	if (shadowStart > addr)
+		StoreBlocks(addr, pData, shadowStart - addr, epoch);
+	StoreToShadow(shadowStart, (const char *)pData + (shadowStart - addr), shadowEnd - shadowStart);
+	if (shadowEnd < (addr + length))
+		StoreBlocks(shadowEnd, (const char *)pData + (shadowEnd - addr), addr + length - shadowEnd, epoch);
+}
+
+void MSP430Proxy::TargetMemoryCache::Invalidate( unsigned addr, size_t length )
+{
+	unsigned shadowStart, shadowEnd;
+	if (!GetShadowIntersection(addr, length, &shadowStart, &shadowEnd))
+	{
+		InvalidateBlocks(addr, length);
+		return;
+	}
+
+	if (shadowStart > addr)
+		InvalidateBlocks(addr, shadowStart - addr);
+	for (unsigned seg = GetShadowSegment(shadowStart); seg <= GetShadowSegment(shadowEnd - 1); seg++)
+		m_ShadowSegmentValid[seg] = false;
+	if (shadowEnd < (addr + length))
+		InvalidateBlocks(shadowEnd, addr + length - shadowEnd);
+}
+
+void MSP430Proxy::TargetMemoryCache::OnFLASHErased( unsigned addr, size_t length )
+{
+	unsigned shadowStart, shadowEnd;
+	if (!GetShadowIntersection(addr, length, &shadowStart, &shadowEnd))
+	{
+		InvalidateBlocks(addr, length);
+		return;
+	}
+
+	if (shadowStart > addr)
+		InvalidateBlocks(addr, shadowStart - addr);
+
+	//Erasing always affects entire physical segments
+	unsigned firstSeg = GetShadowSegment(shadowStart);
+	unsigned lastSeg = GetShadowSegment(shadowEnd - 1);
+	size_t eraseStart, eraseEnd, unused;
+	GetShadowSegmentBounds(firstSeg, &eraseStart, &unused);
+	GetShadowSegmentBounds(lastSeg, &unused, &eraseEnd);
+
+	memset(&m_ShadowImage[eraseStart], 0xFF, eraseEnd - eraseStart);
+	for (unsigned seg = firstSeg; seg <= lastSeg; seg++)
+		m_ShadowSegmentValid[seg] = true;
+
+	if (shadowEnd < (addr + length))
+		InvalidateBlocks(shadowEnd, addr + length - shadowEnd);
+}
+
+unsigned MSP430Proxy::TargetMemoryCache::GetValidShadowSegmentCount( unsigned *pTotalCount )
+{
+	unsigned count = 0;
+	for (size_t i = 0; i < m_ShadowSegmentValid.size(); i++)
+		if (m_ShadowSegmentValid[i])
+			count++;
+
+	if (pTotalCount)
+		*pTotalCount = (unsigned)m_ShadowSegmentValid.size();
+	return count;
+}
+
+bool MSP430Proxy::TargetMemoryCache::Prefetch( unsigned addr, size_t length )
+{
+	if (!length)
+		return true;
+
+	MemoryRegion *pRegion = m_Regions.Find(addr, length);
+	if ((pRegion->Policy & (rpCacheable | rpPrefetchable)) != (rpCacheable | rpPrefetchable))
+		return true;
+	if (OverlapsPendingWrite(addr, length) && !FlushWrites())
+		return false;
+
+	std::vector<unsigned char> buffer(length);
+
+	unsigned shadowStart, shadowEnd;
+	if (GetShadowIntersection(addr, length, &shadowStart, &shadowEnd) && shadowStart == addr && shadowEnd == (addr + length))
+	{
+		ULONGLONG bytesFromDevice = m_Stats.BytesFromDevice;
+		bool result = ReadFromShadow(addr, &buffer[0], length);
+		pRegion->BytesFromDevice += m_Stats.BytesFromDevice - bytesFromDevice;
+		return result;
+	}
+
+	if (Lookup(addr, &buffer[0], length, GetEpoch(pRegion)))
+		return true;
+
+	m_Stats.Prefetches++;
+	m_Stats.BytesPrefetched += length;
+	m_Stats.BytesFromDevice += length;
+	pRegion->BytesFromDevice += length;
+	if (MSP430_Read_Memory(addr, (char *)&buffer[0], length) != STATUS_OK)
+		return false;
+
+	Store(addr, &buffer[0], length);
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::ReadMemory( unsigned addr, void *pBuffer, size_t length )
+{
+	m_Stats.BytesRequested += length;
+	if (OverlapsPendingWrite(addr, length) && !FlushWrites())
+		return false;
+
+	MemoryRegion *pRegion = m_Regions.Find(addr, length);
+	pRegion->Reads++;
+	pRegion->BytesRead += length;
+
+	ULONGLONG bytesFromDevice = m_Stats.BytesFromDevice;
+	bool result = DoReadMemory(pRegion, addr, pBuffer, length);
+	pRegion->BytesFromDevice += m_Stats.BytesFromDevice - bytesFromDevice;
+	return result;
+}
+
+bool MSP430Proxy::TargetMemoryCache::DoReadMemory( MemoryRegion *pRegion, unsigned addr, void *pBuffer, size_t length )
+{
+	if (!(pRegion->Policy & rpCacheable))
+	{
+		m_Stats.UncachedReads++;
+		m_Stats.BytesFromDevice += length;
+		return MSP430_Read_Memory(addr, (char *)pBuffer, length) == STATUS_OK;
+	}
+
+	unsigned shadowStart, shadowEnd;
+	if (GetShadowIntersection(addr, length, &shadowStart, &shadowEnd) && shadowStart == addr && shadowEnd == (addr + length))
+		return ReadFromShadow(addr, pBuffer, length);
+
+	if (Lookup(addr, pBuffer, length, GetEpoch(pRegion)))
+	{
+		m_Stats.Hits++;
+		m_Stats.BytesFromCache += length;
+		return true;
+	}
+
+	m_Stats.Misses++;
+
+	if (length < pRegion->ReadAheadSize)
+	{
+		unsigned blockStart = addr & ~(pRegion->ReadAheadSize - 1);
+		unsigned blockEnd = (unsigned)(addr + length - 1) | (pRegion->ReadAheadSize - 1);
+		if (blockStart < pRegion->Start)
+			blockStart = pRegion->Start;
+		if (blockEnd > pRegion->End)
+			blockEnd = pRegion->End;
+
+		unsigned char block[MAX_READ_AHEAD_SIZE * 2];
+		size_t blockLength = blockEnd - blockStart + 1;
+		if (blockLength <= sizeof(block))
+		{
+			m_Stats.ReadAheadFetches++;
+			m_Stats.BytesFromDevice += blockLength;
+			if (MSP430_Read_Memory(blockStart, (char *)block, blockLength) != STATUS_OK)
+				return false;
+
+			Store(blockStart, block, blockLength);
+			memcpy(pBuffer, block + (addr - blockStart), length);
+			return true;
+		}
+	}
+
+	m_Stats.BytesFromDevice += length;
+	if (MSP430_Read_Memory(addr, (char *)pBuffer, length) != STATUS_OK)
+		return false;
+
+	Store(addr, pBuffer, length);
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::WriteMemory( unsigned addr, const void *pData, size_t length )
+{
+	MemoryRegion *pRegion = m_Regions.Find(addr, length);
+	pRegion->Writes++;
+	pRegion->BytesWritten += length;
+
+	if (!(pRegion->Policy & rpWriteCombining) || !m_CombinedWriteScopes)
+	{
+		if (OverlapsPendingWrite(addr, length) && !FlushWrites())
+			return false;
+		return DoWriteMemory(pRegion, addr, pData, length);
+	}
+
+	if (!m_PendingWrite.empty())
+	{
+		unsigned pendingEnd = (unsigned)(m_PendingWriteStart + m_PendingWrite.size());
+		unsigned mergedStart = (addr < m_PendingWriteStart) ? addr : m_PendingWriteStart;
+		unsigned mergedEnd = ((addr + length) > pendingEnd) ? (unsigned)(addr + length) : pendingEnd;
+		if (pRegion != m_pPendingWriteRegion || addr > pendingEnd || (addr + length) < m_PendingWriteStart || (mergedEnd - mergedStart) > MAX_COMBINED_WRITE_SIZE)
+		{
+			if (!FlushWrites())
+				return false;
+		}
+		else if (addr < m_PendingWriteStart)
+		{
+			m_PendingWrite.insert(m_PendingWrite.begin(), m_PendingWriteStart - addr, 0);
+			m_PendingWriteStart = addr;
+		}
+	}
+
+	if (m_PendingWrite.empty())
+	{
+		m_pPendingWriteRegion = pRegion;
+		m_PendingWriteStart = addr;
+	}
+
+	size_t offset = addr - m_PendingWriteStart;
+	if ((offset + length) > m_PendingWrite.size())
+		m_PendingWrite.resize(offset + length);
+	memcpy(&m_PendingWrite[offset], pData, length);
+	m_Stats.CombinedWrites++;
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::FlushWrites()
+{
+	if (m_PendingWrite.empty())
+		return true;
+
+	std::vector<unsigned char> data;
+	data.swap(m_PendingWrite);
+	m_Stats.WriteFlushes++;
+	return DoWriteMemory(m_pPendingWriteRegion, m_PendingWriteStart, &data[0], data.size());
+}
+
+bool MSP430Proxy::TargetMemoryCache::DoWriteMemory( MemoryRegion *pRegion, unsigned addr, const void *pData, size_t length )
+{
+	if (MSP430_Write_Memory(addr, (char *)pData, length) != STATUS_OK)
+	{
+		Invalidate(addr, length);
+		return false;
+	}
+
+	if (pRegion->Policy & rpWriteThrough)
+		Store(addr, pData, length);
+	else
+		Invalidate(addr, length);
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::IsFLASHShadowLoaded( unsigned addr, size_t length )
+{
+	unsigned shadowStart, shadowEnd;
+	if (!GetShadowIntersection(addr, length, &shadowStart, &shadowEnd) || shadowStart != addr || shadowEnd != (addr + length))
+		return false;
+
+	for (unsigned seg = GetShadowSegment(shadowStart); seg <= GetShadowSegment(shadowEnd - 1); seg++)
+		if (!m_ShadowSegmentValid[seg])
+			return false;
+
+	return true;
+}
+
+bool MSP430Proxy::TargetMemoryCache::VerifyFLASHShadow( unsigned addr, size_t length )
+{
+	//MSP430_VerifyMem() only accepts even addresses and lengths
+	unsigned start = addr & ~1;
+	unsigned end = (unsigned)(addr + length + 1) & ~1;
+	if (start < m_ShadowStart || end > (m_ShadowEnd + 1))
+		return false;
+
+	if (!IsFLASHShadowLoaded(start, end - start))
+		return false;
+
+	if (MSP430_VerifyMem(start, end - start, (char *)&m_ShadowImage[start - m_ShadowStart]) != STATUS_OK)
+	{
+		Invalidate(start, end - start);
+		return false;
+	}
+
+	return true;
+}
+
+void MSP430Proxy::TargetMemoryCache::ImportFLASHShadow( const std::vector<unsigned char> &image, const std::vector<bool> &validSegments )
+{
+	if (image.size() != m_ShadowImage.size() || validSegments.size() != m_ShadowSegmentValid.size())
+		return;
+
+	for (size_t seg = 0; seg < validSegments.size(); seg++)
+	{
+		if (!validSegments[seg])
+			continue;
+
+		size_t offset, end;
+		GetShadowSegmentBounds((unsigned)seg, &offset, &end);
+		memcpy(&m_ShadowImage[offset], &image[offset], end - offset);
+		m_ShadowSegmentValid[seg] = true;
+	}
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <map>
+#include <vector>
+#include "MemoryRegionTable.h"
+
+namespace MSP430Proxy
+{
+	//! Caches the target memory contents while the target is stopped
+	/*! After each stop gdb reads the same stack words, locals and globals multiple times while unwinding the stack and
+		displaying variables. This class keeps the memory contents read from the device in fixed-size blocks tagged with a "stop epoch".
+		The epoch is advanced each time the target is resumed, so all previously cached blocks become invalid at once.
+		\remarks All reads and writes are dispatched through the region table filled by AddRegion(). Only regions with the
+				 rpCacheable policy are cached. All other reads (e.g. peripheral registers) always go to the device.
+				 Blocks from the rpImmutableWhileHalted regions are not invalidated when the epoch is advanced.
+
+		\section read_ahead Read-ahead
+		gdb often reads the memory in small 2- or 4-byte chunks at nearby addresses. Each prefetchable region can have a read-ahead
+		block size. Reads smaller than it are widened to the aligned block (clipped to the region), so that the
+		following neighbouring reads are served from the cache.
+
+		\section flash_shadow FLASH shadow
+		The main FLASH memory can only be modified by the proxy itself (erasing, programming and setting software breakpoints),
+		so its contents does not depend on the stop epoch. If EnableFLASHShadow() is called, the cache keeps a full host-side image
+		of the FLASH memory. Each segment is read from the device once (or filled in when it is erased and programmed) and all further
+		reads (e.g. disassembly or constant data) are served from the host memory.
+
+		\section write_combining Write combining
+		Scripts setting many variables or restoring binary blobs produce streams of small writes. Between BeginCombinedWrites() and
+		EndCombinedWrites() the writes to the rpWriteCombining regions are collected in a single buffer as long as each write is adjacent
+		to or overlaps the buffered range. The buffer is sent to the device with one MSP430_Write_Memory() call when a non-adjacent write
+		arrives, when a read or a write from another region overlaps it, or when FlushWrites() is called. A failed transfer is reported
+		by the call that caused it. The scopes can be nested: MSP430GDBTarget keeps one open for the entire gdb session (unless
+		--nowritecombine is specified) and flushes the buffer before resuming the target, changing breakpoints, programming FLASH
+		or checking the memory with MSP430_VerifyMem(). Outside of any scope all writes go to the device immediately.
+	*/
+	class TargetMemoryCache
+	{
+	public:
+		struct Statistics
+		{
+			unsigned Hits, Misses, UncachedReads, ReadAheadFetches, Prefetches;
+			unsigned CombinedWrites, WriteFlushes;
+			ULONGLONG BytesRequested, BytesFromCache, BytesFromDevice, BytesPrefetched;
+
+			Statistics()
+			{
+				memset(this, 0, sizeof(*this));
+			}
+		};
+
+	private:
+		enum {BLOCK_SIZE = 64, MAX_READ_AHEAD_SIZE = 1024, MAX_COMBINED_WRITE_SIZE = 4096};
+
+		//! Blocks from the immutable regions are tagged with this epoch, so that they never expire
+		enum {PERMANENT_EPOCH = 0};
+
+		struct Block
+		{
+			unsigned Epoch;
+			//! Contains one bit per each byte of Data
+			ULONGLONG ValidMask;
+			unsigned char Data[BLOCK_SIZE];
+		};
+
+		typedef std::map<unsigned, Block> BlockMap;
+
+		BlockMap m_Blocks;
+		MemoryRegionTable m_Regions;
+		unsigned m_Epoch;
+		Statistics m_Stats;
+
+		unsigned m_ShadowStart, m_ShadowEnd, m_ShadowSegmentSize;
+		std::vector<unsigned char> m_ShadowImage;
+		std::vector<bool> m_ShadowSegmentValid;
+
+		MemoryRegion *m_pPendingWriteRegion;
+		unsigned m_PendingWriteStart;
+		std::vector<unsigned char> m_PendingWrite;
+		//! Number of nested BeginCombinedWrites() calls
+		unsigned m_CombinedWriteScopes;
+
+	private:
+		static ULONGLONG MakeMask(unsigned offset, size_t count)
+		{
+			return ((count >= BLOCK_SIZE) ? ~0ULL : ((1ULL << count) - 1)) << offset;
+		}
+
+		unsigned GetEpoch(const MemoryRegion *pRegion)
+		{
+			return (pRegion->Policy & rpImmutableWhileHalted) ? PERMANENT_EPOCH : m_Epoch;
+		}
+
+		bool Lookup(unsigned addr, void *pBuffer, size_t length, unsigned epoch);
+		bool DoReadMemory(MemoryRegion *pRegion, unsigned addr, void *pBuffer, size_t length);
+
+		void StoreBlocks(unsigned addr, const void *pData, size_t length, unsigned epoch);
+		void InvalidateBlocks(unsigned addr, size_t length);
+
+		//! Returns the part of the given range covered by the FLASH shadow as [*pStart, *pEnd)
+		bool GetShadowIntersection(unsigned addr, size_t length, unsigned *pStart, unsigned *pEnd);
+
+		//! Returns the index of the physical FLASH segment containing the given address. Segments are aligned to absolute segment boundaries.
+		unsigned GetShadowSegment(unsigned addr)
+		{
+			return (addr / m_ShadowSegmentSize) - (m_ShadowStart / m_ShadowSegmentSize);
+		}
+
+		//! Returns the part of m_ShadowImage covered by the given segment as [*pStart, *pEnd)
+		void GetShadowSegmentBounds(unsigned seg, size_t *pStart, size_t *pEnd);
+		bool ReadFromShadow(unsigned addr, void *pBuffer, size_t length);
+		void StoreToShadow(unsigned addr, const void *pData, size_t length);
+
+		bool DoWriteMemory(MemoryRegion *pRegion, unsigned addr, const void *pData, size_t length);
+
+		bool OverlapsPendingWrite(unsigned addr, size_t length)
+		{
+			return !m_PendingWrite.empty() && (addr + length) > m_PendingWriteStart && addr < (m_PendingWriteStart + m_PendingWrite.size());
+		}
+
+	public:
+		TargetMemoryCache()
+			: m_Epoch(PERMANENT_EPOCH + 1)
+			, m_ShadowStart(0)
+			, m_ShadowEnd(0)
+			, m_ShadowSegmentSize(0)
+			, m_pPendingWriteRegion(NULL)
+			, m_PendingWriteStart(0)
+			, m_CombinedWriteScopes(0)
+		{
+		}
+
+		//! Adds a memory region with the given access policy (combination of MemoryRegionPolicy flags)
+		/*!
+			\param readAheadSize Specifies the minimum amount of bytes (power of 2) fetched from the device on a cache miss. 0 disables read-ahead.
+		*/
+		void AddRegion(const char *pName, unsigned start, unsigned end, unsigned policy, unsigned readAheadSize = 0);
+
+		MemoryRegionTable &GetRegionTable()
+		{
+			return m_Regions;
+		}
+
+		//! Keeps a host-side image of the given FLASH range that is not invalidated when the target is resumed
+		/*! The shadow is tracked per physical segment (see GetFLASHSegmentBounds()), so the range does not need to start on a segment boundary. */
+		void EnableFLASHShadow(unsigned start, unsigned end, unsigned segmentSize);
+
+		//! Reads the target memory, using the cached data when possible
+		bool ReadMemory(unsigned addr, void *pBuffer, size_t length);
+
+		//! Writes the target memory and updates the cache according to the region policy
+		bool WriteMemory(unsigned addr, const void *pData, size_t length);
+
+		//! Sends the contents of the write-combining buffer to the device
+		/*! \return False if the buffered data could not be written. The affected range is then invalidated. */
+		bool FlushWrites();
+
+		//! Starts buffering the writes to the rpWriteCombining regions (see \ref write_combining)
+		void BeginCombinedWrites()
+		{
+			m_CombinedWriteScopes++;
+		}
+
+		//! Sends the buffered writes to the device and closes the scope opened by BeginCombinedWrites()
+		/*! \return False if the buffered writes could not be completed */
+		bool EndCombinedWrites()
+		{
+			if (m_CombinedWriteScopes)
+				m_CombinedWriteScopes--;
+			return FlushWrites();
+		}
+
+		//! Reads the given range into the cache unless it is already cached. Ranges that are not prefetchable are ignored.
+		bool Prefetch(unsigned addr, size_t length);
+
+		//! Saves the given data to the cache. Should be called when the exact memory contents are known (e.g. after a verified write)
+		/*! Data outside the cacheable regions is not stored. */
+		void Store(unsigned addr, const void *pData, size_t length);
+
+		//! Discards all cached data overlapping the given range
+		void Invalidate(unsigned addr, size_t length);
+
+		//! Updates the FLASH shadow after the FLASH segments covering the given range have been erased
+		void OnFLASHErased(unsigned addr, size_t length);
+
+		//! Invalidates all cached blocks. Should be called each time the target is resumed.
+		void AdvanceEpoch()
+		{
+			if (++m_Epoch == PERMANENT_EPOCH)
+				m_Epoch++;
+		}
+
+		const Statistics &GetStatistics()
+		{
+			return m_Stats;
+		}
+
+		//! Returns true if the given range is fully covered by the loaded FLASH shadow segments
+		bool IsFLASHShadowLoaded(unsigned addr, size_t length);
+
+		//! Checks that the device contents matches the FLASH shadow using the device-side checksum (MSP430_VerifyMem())
+		/*!
+			\return True if the range is covered by the loaded shadow segments and the device contents matches them.
+					If the device contents differs, the affected segments are discarded.
+			\remarks MSP430_VerifyMem() resets the device, so the caller is responsible for preserving the CPU state.
+		*/
+		bool VerifyFLASHShadow(unsigned addr, size_t length);
+
+		//! Returns a copy of the FLASH shadow image and the list of the loaded segments
+		bool ExportFLASHShadow(std::vector<unsigned char> &image, std::vector<bool> &validSegments)
+		{
+			if (m_ShadowImage.empty())
+				return false;
+			image = m_ShadowImage;
+			validSegments = m_ShadowSegmentValid;
+			return true;
+		}
+
+		//! Loads the given segments into the FLASH shadow. The caller should ensure that the device contents matches them.
+		void ImportFLASHShadow(const std::vector<unsigned char> &image, const std::vector<bool> &validSegments);
+
+		//! Returns the amount of FLASH shadow segments that are currently loaded
+		unsigned GetValidShadowSegmentCount(unsigned *pTotalCount);
+	};
+}
@@ -1,66 +1,100 @@
-#pragma once
-
-namespace MSP430Proxy
-{
-	enum BreakpointPolicy
-	{
-		HardwareOnly,
-		HardwareThenSoftware,
-		SoftwareOnly,
-	};
-
-	enum HardwareInterface
-	{
-		UnspecifiedInterface,
-		Jtag,
-		SpyBiWare,
-		JtagOverSpyBiWare,
-		AutomaticInterface,
-	};
-
-	enum HardwareInterfaceSpeed
-	{
-		UnspecifiedSpeed,
-		Fast,
-		Medium,
-		Slow
-	};
-
-	struct GlobalSettings
-	{
-		bool EnableEEMMode;
-		bool InstantBreakpointCleanup;
-		unsigned short BreakpointInstruction;
-		BreakpointPolicy SoftBreakPolicy;
-		const char *PortName;
-		unsigned Voltage;
-		int ListenPort;
-		bool SingleSessionOnly;
-		bool AutoErase;
-		bool NoHint;
-		bool Verbose;
-		HardwareInterface Interface;
-		HardwareInterfaceSpeed InterfaceSpeed;
-		bool Emulate32BitRegisters;
-		bool EraseInfoMem;
-
-		GlobalSettings()
-		{
-			EnableEEMMode = true;
-			InstantBreakpointCleanup = true;
-			BreakpointInstruction = 0x4343;
-			SoftBreakPolicy = HardwareThenSoftware;
-			PortName = "USB";
-			Voltage = 3333;
-			ListenPort = 2000;
-			SingleSessionOnly = true;
-			AutoErase = false;
-			NoHint = false;
-			Verbose = false;
-			Interface = UnspecifiedInterface;
-			InterfaceSpeed = UnspecifiedSpeed;
-			Emulate32BitRegisters = false;
-			EraseInfoMem = false;
-		}
-	};
+#pragma once
+
+namespace MSP430Proxy
+{
+	enum BreakpointPolicy
+	{
+		HardwareOnly,
+		HardwareThenSoftware,
+		SoftwareOnly,
+	};
+
+	enum HardwareInterface
+	{
+		UnspecifiedInterface,
+		Jtag,
+		SpyBiWare,
+		JtagOverSpyBiWare,
+		AutomaticInterface,
+	};
+
+	enum HardwareInterfaceSpeed
+	{
+		UnspecifiedSpeed,
+		Fast,
+		Medium,
+		Slow
+	};
+
+	struct GlobalSettings
+	{
+		bool EnableEEMMode;
+		bool InstantBreakpointCleanup;
+		unsigned short BreakpointInstruction;
+		BreakpointPolicy SoftBreakPolicy;
+		const char *PortName;
+		unsigned Voltage;
+		int ListenPort;
+		bool SingleSessionOnly;
+		bool AutoErase;
+		bool NoHint;
+		bool Verbose;
+		HardwareInterface Interface;
+		HardwareInterfaceSpeed InterfaceSpeed;
+		bool Emulate32BitRegisters;
+		bool EraseInfoMem;
+		bool FLASHShadow;
+		unsigned RAMReadAheadSize;
+		unsigned FLASHReadAheadSize;
+		bool StopPrefetch;
+		//! Directory for the saved FLASH images. NULL disables the image cache, empty string selects the default directory.
+		const char *FLASHImageCacheDir;
+		bool FastLoad;
+		//! Program the FLASH segments on a worker thread while gdb is sending the next vFlashWrite packets
+		bool PipelinedFLASHLoad;
+		bool CountFLASHWear;
+		bool RAMWriteCombining;
+		//! Image to program without starting the gdb server (see ProgramImageWithoutGDB())
+		const char *ProgramImage;
+		bool VerifyImage;
+		//! Program the image with several probes in parallel (see ProgramImageOnMultipleProbes())
+		bool GangProgramming;
+		//! Comma-separated list of the probe ports for the gang mode. NULL or empty selects all free USB FETs.
+		const char *GangPorts;
+		//! Amount of erase cycles of a single segment after which a warning is shown (0 = never)
+		unsigned FLASHWearWarningThreshold;
+
+		GlobalSettings()
+		{
+			EnableEEMMode = true;
+			InstantBreakpointCleanup = true;
+			BreakpointInstruction = 0x4343;
+			SoftBreakPolicy = HardwareThenSoftware;
+			PortName = "USB";
+			Voltage = 3333;
+			ListenPort = 2000;
+			SingleSessionOnly = true;
+			AutoErase = false;
+			NoHint = false;
+			Verbose = false;
+			Interface = UnspecifiedInterface;
+			InterfaceSpeed = UnspecifiedSpeed;
+			Emulate32BitRegisters = false;
+			EraseInfoMem = false;
+			FLASHShadow = true;
+			RAMReadAheadSize = 64;
+			FLASHReadAheadSize = 256;
+			StopPrefetch = true;
+			FLASHImageCacheDir = NULL;
+			FastLoad = false;
+			PipelinedFLASHLoad = true;
+			CountFLASHWear = true;
+			RAMWriteCombining = true;
+			ProgramImage = NULL;
+			VerifyImage = false;
+			GangProgramming = false;
+			GangPorts = NULL;
+			FLASHWearWarningThreshold = 10000;
+		}
+	};
 }
\ No newline at end of file